@@ -43,6 +43,10 @@ namespace ospray {
     {
       virtual void getRay(const CameraSample &cameraSample, Ray &ray) const = 0;
       virtual void commit() override;
+
+      //! Growth of a pixel's footprint per unit distance along a primary ray
+      //! (0 if unknown).
+      virtual float pixelSpread(const vec2i &frameSize) const;
     };
 
     // Inlined members ////////////////////////////////////////////////////////
@@ -60,5 +64,11 @@ namespace ospray {
       clamp(imageEnd, imageStart, vec2f(1.f));
     }
 
+    inline float Camera::pixelSpread(const vec2i &frameSize) const
+    {
+      UNUSED(frameSize);
+      return 0.f;
+    }
+
   }// namespace cpp_renderer
 }// namespace ospray
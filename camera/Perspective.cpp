@@ -95,6 +95,12 @@ namespace ospray {
       ray.t   = inf;
     }
 
+    float PerspectiveCamera::pixelSpread(const vec2i &frameSize) const
+    {
+      // Height of a pixel on the image plane at unit distance.
+      return length(dir_dv) * (imageEnd.y - imageStart.y) / frameSize.y;
+    }
+
     OSP_REGISTER_CAMERA(PerspectiveCamera, cpp_perspective);
     OSP_REGISTER_CAMERA(PerspectiveCamera, cpp_perspective_stream);
 
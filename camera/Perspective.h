@@ -27,6 +27,8 @@ namespace ospray {
 
       void getRay(const CameraSample &sample, Ray &ray) const override;
 
+      float pixelSpread(const vec2i &frameSize) const override;
+
     public:
       // ------------------------------------------------------------------
       // the parameters we 'parsed' from our parameters
@@ -102,5 +102,24 @@ namespace ospray {
       resetRay(rays[i]);
     }
 
+    inline std::pair<simd::vfloat, simd::vfloat>
+    intersectBox(const RayN &ray, const box3f &box)
+    {
+      const simd::vec3f rcpDir = rcp(ray.dir);
+      const simd::vec3f mins = (simd::vec3f{box.lower} - ray.org) * rcpDir;
+      const simd::vec3f maxs = (simd::vec3f{box.upper} - ray.org) * rcpDir;
+
+      const simd::vfloat tNear =
+          simd::max(simd::max(simd::min(mins.x, maxs.x),
+                              simd::min(mins.y, maxs.y)),
+                    simd::max(simd::min(mins.z, maxs.z), ray.t0));
+      const simd::vfloat tFar =
+          simd::min(simd::min(simd::max(mins.x, maxs.x),
+                              simd::max(mins.y, maxs.y)),
+                    simd::min(simd::max(mins.z, maxs.z), ray.t));
+
+      return {tNear, tFar};
+    }
+
   }// ::ospray::cpp_renderer
 } // ::ospray
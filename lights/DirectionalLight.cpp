@@ -77,6 +77,11 @@ namespace ospray {
       return res;
     }
 
+    vec3f DirectionalLight::getDirection() const
+    {
+      return direction;
+    }
+
     OSP_REGISTER_LIGHT(DirectionalLight, cpp_DirectionalLight);
     OSP_REGISTER_LIGHT(DirectionalLight, cpp_DistantLight);
     OSP_REGISTER_LIGHT(DirectionalLight, cpp_distant);
@@ -37,6 +37,9 @@ namespace ospray {
                            const vec3f &dir,
                            float maxDist) const override;
 
+        //! Unit direction *towards* the light source.
+        vec3f getDirection() const;
+
       private:
 
         vec3f direction {0.f, 0.f, 1.f};//!< Direction of the emitted rays
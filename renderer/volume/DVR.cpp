@@ -16,6 +16,8 @@
 
 #include "DVR.h"
 
+#include <algorithm>
+
 namespace ospray {
   namespace cpp_renderer {
 
@@ -64,17 +66,36 @@ namespace ospray {
     void DVRenderer::commit()
     {
       cpp_renderer::Renderer::commit();
+      lighting = getDVRLighting((Data*)getParamData("lights"));
+      surfacesEnabled = getParam1i("surfacesEnabled", 0);
+      shadowsEnabled = getParam1i("shadowsEnabled", 0);
+      shadowResolution = std::max(2, getParam1i("shadowResolution", 64));
     }
 
     void *DVRenderer::beginFrame(FrameBuffer *fb)
     {
-      auto &volumes = model->volume;
+      volumes.clear();
+
+      for (auto &volume : model->volume) {
+        auto *cppVolume = dynamic_cast<cpp_renderer::Volume*>(volume.ptr);
+        if (cppVolume)
+          volumes.push_back(cppVolume);
+      }
 
-      if (!volumes.empty()) {
-        currentVolume = dynamic_cast<cpp_renderer::Volume*>(volumes[0].ptr);
+      // Shadow grids are only rebuilt for volumes, transfer functions or
+      // lights which changed.
+      if (shadowsEnabled) {
+        shadows.update(volumes, lighting.lights, shadowResolution);
+        lighting.shadows = &shadows;
+      } else {
+        lighting.shadows = nullptr;
       }
 
-      return cpp_renderer::Renderer::beginFrame(fb);
+      auto *perFrameData = cpp_renderer::Renderer::beginFrame(fb);
+
+      pixelSpread = currentCamera->pixelSpread(fb->size);
+
+      return perFrameData;
     }
 
     void DVRenderer::renderSample(void *perFrameData,
@@ -84,47 +105,45 @@ namespace ospray {
 
       sample.rgb = bgColor;
 
-      if (currentVolume == nullptr)
-        return;
+      auto &ray = sample.ray;
 
-      auto &ray      = sample.ray;
-      auto hitVolume = currentVolume->intersect(ray);
+      // The nearest surface bounds the volume march ('ray.t' is its distance).
+      const bool hitSurface = surfacesEnabled && traceRay(ray);
 
-      if (hitVolume) {
-        vec3f color {0.f};
-        float opacity {0.f};
-        const auto &volume = *currentVolume;
-        const auto &tFcn   = *volume.transferFunction;
-
-        static std::uniform_real_distribution<float> distribution {0.f, 1.f};
-        const auto offsetStepSize = (volume.samplingStep / volume.samplingRate);
-        ray.t0 += distribution(rng) * offsetStepSize;
+      if (volumes.empty() && !hitSurface)
+        return;
 
-        ///////////////////////////////////////////////////////////////////////
-        // NOTE(jda) - this section needs to be a function/object!
-        while (ray.t0 < ray.t) {
-          auto samplePoint  = ray.org + ray.t0 * ray.dir;
-          auto volumeSample = volume.computeSample(samplePoint);
+      static std::uniform_real_distribution<float> distribution {0.f, 1.f};
+      static thread_local std::vector<DVRVolumeInterval> intervals;
 
-          auto sampleColor   = tFcn.color(volumeSample);
-          auto sampleOpacity = tFcn.opacity(volumeSample);
+      DVRRayState state;
+      state.pixelSpread = pixelSpread;
+      state.lighting    = &lighting;
 
-          auto clampedOpacity = clamp(sampleOpacity / volume.samplingRate);
-          sampleColor *= clampedOpacity;
+      if (!volumes.empty())
+        integrateVolumes(volumes, ray, distribution(rng), state, intervals);
 
-          color   += (1.f - opacity) * sampleColor;
-          opacity += (1.f - opacity) * clampedOpacity;
+      if (hitSurface && state.opacity < 0.99f) {
+        auto dg = postIntersect(ray, DG_NG|DG_NS|DG_NORMALIZE|DG_FACEFORWARD|
+                                     DG_MATERIALID|DG_COLOR);
 
-          if (opacity >= 0.99f)
-            break;
+        const vec3f color {dg.color.x, dg.color.y, dg.color.z};
+        auto *mat = dynamic_cast<DVMaterial*>(dg.material);
 
-          currentVolume->advance(ray);
+        if (mat) {
+          compositeSurface(lighting, dg, ray, mat->Kd * color,
+                           mat->Ks, mat->Ns, mat->d, state);
+        } else {
+          compositeSurface(lighting, dg, ray, color,
+                           vec3f(0.f), 10.f, 1.f, state);
         }
-        ///////////////////////////////////////////////////////////////////////
-
-        sample.rgb *= (1.f - opacity);
-        sample.rgb += opacity * color;
       }
+
+      if (hitSurface)
+        sample.z = ray.t;
+
+      sample.rgb *= (1.f - state.opacity);
+      sample.rgb += state.opacity * state.color;
     }
 
     Material *DVRenderer::createMaterial(const char *type)
@@ -18,6 +18,7 @@
 
 #include "../Renderer.h"
 #include "../../volume/Volume.h"
+#include "dvr_util.h"
 
 namespace ospray {
   namespace cpp_renderer {
@@ -36,7 +37,25 @@ namespace ospray {
 
     private:
 
-      Volume *currentVolume {nullptr};// NOTE(jda) - just a convenience ptr
+      //! The model's volumes, gathered in beginFrame().
+      std::vector<Volume*> volumes;
+
+      //! Lights for gradient shaded volumes (and surfaces).
+      DVRLighting lighting;
+
+      //! Volume shadows towards the directional lights ("shadowsEnabled"),
+      //! brought up to date in beginFrame().
+      VolumeShadows shadows;
+      bool shadowsEnabled {false};
+
+      //! Shadow grid points along the longest side of a volume.
+      int shadowResolution {64};
+
+      //! Trace the model's geometry first and march volumes up to the hit.
+      bool surfacesEnabled {false};
+
+      //! Camera pixel footprint growth per unit distance, for volume LOD.
+      float pixelSpread {0.f};
     };
 
   }// ::ospray::cpp_renderer
@@ -0,0 +1,207 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "SimdDVR.h"
+
+#include <algorithm>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    // Material definition ////////////////////////////////////////////////////
+
+    struct SimdDVMaterial : public ospray::Material
+    {
+      void commit() override;
+
+      float d;
+      vec3f Kd;
+      vec3f Ks;
+      float Ns;
+
+      Ref<Texture2D> map_d;
+      Ref<Texture2D> map_Kd;
+      Ref<Texture2D> map_Ks;
+      Ref<Texture2D> map_Ns;
+    };
+
+    void SimdDVMaterial::commit()
+    {
+      map_d  = (Texture2D*)getParamObject("map_d", nullptr);
+      map_Kd = (Texture2D*)getParamObject("map_Kd",
+                                          getParamObject("map_kd", nullptr));
+      map_Ks = (Texture2D*)getParamObject("map_Ks",
+                                          getParamObject("map_ks", nullptr));
+      map_Ns = (Texture2D*)getParamObject("map_Ns",
+                                          getParamObject("map_ns", nullptr));
+
+      d  = getParam1f("d", 1.f);
+      Kd = getParam3f("kd", getParam3f("Kd", vec3f(.8f)));
+      Ks = getParam3f("ks", getParam3f("Ks", vec3f(0.f)));
+      Ns = getParam1f("ns", getParam1f("Ns", 10.f));
+    }
+
+    // SimdDVR definitions ////////////////////////////////////////////////////
+
+    std::string SimdDVRenderer::toString() const
+    {
+      return "ospray::cpp_renderer::SimdDVRenderer";
+    }
+
+    void SimdDVRenderer::commit()
+    {
+      cpp_renderer::SimdRenderer::commit();
+      lighting = getDVRLighting((Data*)getParamData("lights"));
+      shadowsEnabled = getParam1i("shadowsEnabled", 0);
+      shadowResolution = std::max(2, getParam1i("shadowResolution", 64));
+    }
+
+    void *SimdDVRenderer::beginFrame(FrameBuffer *fb)
+    {
+      auto &volumes = model->volume;
+
+      if (!volumes.empty()) {
+        currentVolume = dynamic_cast<cpp_renderer::Volume*>(volumes[0].ptr);
+      }
+
+      // Shadow grids are only rebuilt for volumes, transfer functions or
+      // lights which changed.
+      if (shadowsEnabled && currentVolume) {
+        shadows.update({currentVolume}, lighting.lights, shadowResolution);
+        lighting.shadows = &shadows;
+      } else {
+        lighting.shadows = nullptr;
+      }
+
+      return cpp_renderer::SimdRenderer::beginFrame(fb);
+    }
+
+    void SimdDVRenderer::renderSample(simd::vmaski active,
+                                      void *perFrameData,
+                                      ScreenSampleN &sample) const
+    {
+      UNUSED(perFrameData);
+
+      sample.rgb = simd::vec3f{bgColor};
+
+      if (currentVolume == nullptr)
+        return;
+
+      auto &ray      = sample.ray;
+      auto hitVolume = currentVolume->intersect(active, ray);
+
+      if (simd::none(hitVolume))
+        return;
+
+      simd::vec3f  color {simd::vfloat{0.f}};
+      simd::vfloat opacity {0.f};
+      const auto &volume = *currentVolume;
+      const auto &tFcn   = *volume.transferFunction;
+
+      const auto offsetStepSize = (volume.samplingStep / volume.samplingRate);
+      ray.t0 = simd::select(hitVolume,
+                            ray.t0 + simd::randUniformDist() * offsetStepSize,
+                            ray.t0);
+
+      /////////////////////////////////////////////////////////////////////////
+      // March all lanes in lockstep, retiring lanes as they leave the volume
+      // or saturate.
+      simd::vfloat lastSample {0.f};
+      simd::vfloat lastStep {0.f};
+      auto firstSample = hitVolume;
+
+      auto marching = hitVolume & (ray.t0 < ray.t);
+
+      while (simd::any(marching)) {
+        const auto samplePoint  = ray.org + ray.t0 * ray.dir;
+        const auto volumeSample = volume.computeSample(marching, samplePoint);
+
+        lastSample  = simd::select(firstSample, volumeSample, lastSample);
+        firstSample = firstSample & !marching;
+
+        const auto colorOpacity = volume.preIntegrationEnabled ?
+            tFcn.lookupIntegrated(lastSample, volumeSample) :
+            tFcn.lookup(volumeSample);
+
+        simd::vec3f sampleColor {colorOpacity.x,
+                                 colorOpacity.y,
+                                 colorOpacity.z};
+        const simd::vfloat sampleOpacity = colorOpacity.w;
+
+        // Lights and shadows are shaded one lane at a time.
+        if (volume.gradientShadingEnabled) {
+          simd::foreach_active(marching & (sampleOpacity > 0.f), [&](int i) {
+            const vec3f color = shadeVolumeSample(
+                volume, lighting,
+                vec3f{samplePoint.x[i], samplePoint.y[i], samplePoint.z[i]},
+                vec3f{ray.dir.x[i], ray.dir.y[i], ray.dir.z[i]},
+                vec3f{sampleColor.x[i], sampleColor.y[i], sampleColor.z[i]});
+
+            sampleColor.x[i] = color.x;
+            sampleColor.y[i] = color.y;
+            sampleColor.z[i] = color.z;
+          });
+        }
+
+        simd::vfloat clampedOpacity {0.f};
+        auto accepted = marching;
+
+        if (volume.adaptiveSamplingEnabled) {
+          // Correct the opacity for the length of the step which reached
+          // this sample, relative to the volume's reference step.
+          const auto sampleStep = simd::select(lastStep > 0.f,
+                                               lastStep,
+                                               offsetStepSize);
+
+          accepted = volume.advanceAdaptive(marching, ray, lastStep,
+                                            sampleOpacity);
+
+          simd::foreach_active(accepted, [&](int i) {
+            clampedOpacity[i] =
+                1.f - powf(1.f - clamp(sampleOpacity[i]),
+                           sampleStep[i] / volume.samplingStep);
+          });
+        } else {
+          clampedOpacity = sampleOpacity / volume.samplingRate;
+          clampedOpacity = simd::select(clampedOpacity < 1.f,
+                                        clampedOpacity, 1.f);
+          volume.advance(marching, ray);
+        }
+
+        lastSample = simd::select(accepted, volumeSample, lastSample);
+
+        const auto weight = (1.f - opacity) * clampedOpacity;
+
+        color   = simd::select(accepted, color + weight * sampleColor, color);
+        opacity = simd::select(accepted, opacity + weight, opacity);
+
+        marching = marching & (ray.t0 < ray.t) & (opacity < 0.99f);
+      }
+      /////////////////////////////////////////////////////////////////////////
+
+      sample.rgb = (1.f - opacity) * sample.rgb + opacity * color;
+    }
+
+    Material *SimdDVRenderer::createMaterial(const char *type)
+    {
+      UNUSED(type);
+      return new SimdDVMaterial;
+    }
+
+    OSP_REGISTER_RENDERER(SimdDVRenderer, cpp_dvr_simd);
+
+  }// namespace cpp_renderer
+}// namespace ospray
@@ -0,0 +1,63 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "../SimdRenderer.h"
+#include "../../volume/Volume.h"
+#include "dvr_util.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Direct volume renderer marching packets of rays in lockstep, with
+        voxels and transfer function entries gathered for all lanes at once.
+
+        It only renders the model's first volume at full resolution: other
+        volumes, isosurfaces, surface geometry and level of detail selection
+        are not supported (use cpp_dvr for those). Gradient shading is
+        evaluated one lane at a time. */
+    struct SimdDVRenderer : public ospray::cpp_renderer::SimdRenderer
+    {
+      std::string toString() const override;
+      void commit() override;
+
+      void *beginFrame(FrameBuffer *fb) override;
+
+      void renderSample(simd::vmaski active,
+                        void *perFrameData,
+                        ScreenSampleN &sample) const override;
+
+      ospray::Material *createMaterial(const char *type) override;
+
+    private:
+
+      Volume *currentVolume {nullptr};// NOTE(jda) - just a convenience ptr
+
+      //! Lights for gradient shaded volumes.
+      DVRLighting lighting;
+
+      //! Volume shadows towards the directional lights ("shadowsEnabled"),
+      //! brought up to date in beginFrame().
+      VolumeShadows shadows;
+      bool shadowsEnabled {false};
+
+      //! Shadow grid points along the longest side of a volume.
+      int shadowResolution {64};
+    };
+
+  }// namespace cpp_renderer
+}// namespace ospray
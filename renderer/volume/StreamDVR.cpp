@@ -0,0 +1,276 @@
+// ======================================================================== //
+// Copyright 2009-2015 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "StreamDVR.h"
+
+#include <algorithm>
+#include <random>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    static thread_local std::mt19937 rng;
+
+    // Material definition ////////////////////////////////////////////////////
+
+    struct StreamDVMaterial : public ospray::Material
+    {
+      void commit() override;
+
+      float d;
+      vec3f Kd;
+      vec3f Ks;
+      float Ns;
+
+      Ref<Texture2D> map_d;
+      Ref<Texture2D> map_Kd;
+      Ref<Texture2D> map_Ks;
+      Ref<Texture2D> map_Ns;
+    };
+
+    void StreamDVMaterial::commit()
+    {
+      map_d  = (Texture2D*)getParamObject("map_d", nullptr);
+      map_Kd = (Texture2D*)getParamObject("map_Kd",
+                                          getParamObject("map_kd", nullptr));
+      map_Ks = (Texture2D*)getParamObject("map_Ks",
+                                          getParamObject("map_ks", nullptr));
+      map_Ns = (Texture2D*)getParamObject("map_Ns",
+                                          getParamObject("map_ns", nullptr));
+
+      d  = getParam1f("d", 1.f);
+      Kd = getParam3f("kd", getParam3f("Kd", vec3f(.8f)));
+      Ks = getParam3f("ks", getParam3f("Ks", vec3f(0.f)));
+      Ns = getParam1f("ns", getParam1f("Ns", 10.f));
+    }
+
+    // StreamDVR definitions //////////////////////////////////////////////////
+
+    std::string StreamDVRenderer::toString() const
+    {
+      return "ospray::cpp_renderer::StreamDVRenderer";
+    }
+
+    void StreamDVRenderer::commit()
+    {
+      cpp_renderer::StreamRenderer::commit();
+      lighting = getDVRLighting((Data*)getParamData("lights"));
+      stepsPerPass = std::max(1, getParam1i("stepsPerPass", 8));
+      surfacesEnabled = getParam1i("surfacesEnabled", 0);
+      shadowsEnabled = getParam1i("shadowsEnabled", 0);
+      shadowResolution = std::max(2, getParam1i("shadowResolution", 64));
+    }
+
+    void *StreamDVRenderer::beginFrame(FrameBuffer *fb)
+    {
+      volumes.clear();
+
+      for (auto &volume : model->volume) {
+        auto *cppVolume = dynamic_cast<cpp_renderer::Volume*>(volume.ptr);
+        if (cppVolume)
+          volumes.push_back(cppVolume);
+      }
+
+      // Shadow grids are only rebuilt for volumes, transfer functions or
+      // lights which changed.
+      if (shadowsEnabled) {
+        shadows.update(volumes, lighting.lights, shadowResolution);
+        lighting.shadows = &shadows;
+      } else {
+        lighting.shadows = nullptr;
+      }
+
+      auto *perFrameData = cpp_renderer::StreamRenderer::beginFrame(fb);
+
+      pixelSpread = currentCamera->pixelSpread(fb->size);
+
+      return perFrameData;
+    }
+
+    void StreamDVRenderer::renderStream(void */*perFrameData*/,
+                                        ScreenSampleStream &stream) const
+    {
+      for_each_sample(stream,
+                      [&](ScreenSampleRef sample) { sample.rgb = bgColor; },
+                      sampleEnabled);
+
+      if (volumes.empty() && !surfacesEnabled)
+        return;
+
+      // Surfaces are traced first, so their hit distance ('ray.t') bounds the
+      // volume march. Their geometry is resolved up front, as marching reuses
+      // the ray's hit fields.
+      Stream<bool> hitSurface;
+      hitSurface.fill(false);
+
+      DGStream dgs;
+
+      if (surfacesEnabled) {
+        traceRays(stream.rays, RTC_INTERSECT_COHERENT);
+
+        dgs = postIntersect(stream.rays,
+                            DG_NG|DG_NS|DG_NORMALIZE|DG_FACEFORWARD|
+                            DG_MATERIALID|DG_COLOR);
+
+        for_each_sample_i(
+          stream,
+          [&](ScreenSampleRef sample, int i) {
+            hitSurface[i] = sample.ray.hitSomething();
+
+            if (hitSurface[i])
+              sample.z = sample.ray.t;
+          },
+          sampleEnabled
+        );
+      }
+
+      static std::uniform_real_distribution<float> distribution {0.f, 1.f};
+
+      Stream<DVRRayState> states;
+
+      if (volumes.size() > 1) {
+        static thread_local std::vector<DVRVolumeInterval> intervals;
+
+        for_each_sample_i(
+          stream,
+          [&](ScreenSampleRef sample, int i) {
+            states[i].pixelSpread = pixelSpread;
+            states[i].lighting    = &lighting;
+
+            integrateVolumes(volumes, sample.ray, distribution(rng),
+                             states[i], intervals);
+          },
+          sampleEnabled
+        );
+      } else if (volumes.size() == 1) {
+        integrateVolume(*volumes[0], stream, states);
+      }
+
+      for_each_sample_i(
+        stream,
+        [&](ScreenSampleRef sample, int i) {
+          auto &state = states[i];
+
+          if (hitSurface[i] && state.opacity < 0.99f) {
+            const auto &dg = dgs[i];
+            const vec3f color {dg.color.x, dg.color.y, dg.color.z};
+            auto *mat = dynamic_cast<StreamDVMaterial*>(dg.material);
+
+            if (mat) {
+              compositeSurface(lighting, dg, sample.ray, mat->Kd * color,
+                               mat->Ks, mat->Ns, mat->d, state);
+            } else {
+              compositeSurface(lighting, dg, sample.ray, color,
+                               vec3f(0.f), 10.f, 1.f, state);
+            }
+          }
+
+          sample.rgb *= (1.f - state.opacity);
+          sample.rgb += state.opacity * state.color;
+        },
+        sampleEnabled
+      );
+    }
+
+    void StreamDVRenderer::integrateVolume(const Volume &volume,
+                                           ScreenSampleStream &stream,
+                                           Stream<DVRRayState> &states) const
+    {
+      static std::uniform_real_distribution<float> distribution {0.f, 1.f};
+
+      const auto offsetStepSize = (volume.samplingStep / volume.samplingRate);
+
+      Stream<bool> hitIsosurface;
+      hitIsosurface.fill(false);
+
+      // Indices of the rays still marching, compacted after every pass.
+      Stream<int> active;
+      int numActive = 0;
+
+      for_each_sample_i(
+        stream,
+        [&](ScreenSampleRef sample, int i) {
+          auto &ray = sample.ray;
+
+          const float tEnd = ray.t;
+
+          if (!volume.intersect(ray))
+            return;
+
+          ray.t = std::min(ray.t, tEnd);
+
+          hitIsosurface[i] = intersectIsosurfaces(volume, ray);
+
+          ray.t0 += distribution(rng) * offsetStepSize;
+
+          states[i].pixelSpread = pixelSpread;
+          states[i].lighting    = &lighting;
+
+          if (ray.t0 < ray.t)
+            active[numActive++] = i;
+        },
+        sampleEnabled
+      );
+
+      Stream<std::pair<size_t, int>> order;
+
+      while (numActive > 0) {
+        // Visit rays sampling the same brick back to back, so the steps of a
+        // pass walk through memory coherently.
+        for (int k = 0; k < numActive; ++k) {
+          const auto &ray = stream.rays[active[k]];
+          order[k] = {volume.brickID(ray.org + ray.t0 * ray.dir), active[k]};
+        }
+
+        std::sort(order.begin(), order.begin() + numActive);
+
+        int numStillActive = 0;
+
+        for (int k = 0; k < numActive; ++k) {
+          const int i = order[k].second;
+          auto &ray   = stream.rays[i];
+
+          bool marching = true;
+          for (int step = 0; step < stepsPerPass && marching; ++step)
+            marching = integrateVolumeSample(volume, ray, states[i]);
+
+          if (marching)
+            active[numStillActive++] = i;
+        }
+
+        numActive = numStillActive;
+      }
+
+      for_each_sample_i(
+        stream,
+        [&](ScreenSampleRef sample, int i) {
+          if (hitIsosurface[i])
+            compositeIsosurface(volume, sample.ray, states[i]);
+        },
+        sampleEnabled
+      );
+    }
+
+    Material *StreamDVRenderer::createMaterial(const char *type)
+    {
+      UNUSED(type);
+      return new StreamDVMaterial;
+    }
+
+    OSP_REGISTER_RENDERER(StreamDVRenderer, cpp_dvr_stream);
+
+  }// namespace cpp_renderer
+}// namespace ospray
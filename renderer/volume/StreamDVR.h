@@ -0,0 +1,74 @@
+// ======================================================================== //
+// Copyright 2009-2015 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "../StreamRenderer.h"
+#include "../../volume/Volume.h"
+#include "dvr_util.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! DVR over a stream of rays: all rays march a fixed number of steps per
+        pass, finished rays are compacted out between passes and the rays of
+        each pass are visited in order of the brick they are sampling. Models
+        with several volumes are integrated one ray at a time. */
+    struct StreamDVRenderer : public ospray::cpp_renderer::StreamRenderer
+    {
+      std::string toString() const override;
+      void commit() override;
+
+      void *beginFrame(FrameBuffer *fb) override;
+
+      void renderStream(void *perFrameData,
+                        ScreenSampleStream &stream) const override;
+
+      ospray::Material *createMaterial(const char *type) override;
+
+    private:
+
+      //! March a stream through a single volume, compositing into 'states'.
+      void integrateVolume(const Volume &volume,
+                           ScreenSampleStream &stream,
+                           Stream<DVRRayState> &states) const;
+
+      //! The model's volumes, gathered in beginFrame().
+      std::vector<Volume*> volumes;
+
+      //! Lights for gradient shaded volumes.
+      DVRLighting lighting;
+
+      //! Volume shadows towards the directional lights ("shadowsEnabled"),
+      //! brought up to date in beginFrame().
+      VolumeShadows shadows;
+      bool shadowsEnabled {false};
+
+      //! Shadow grid points along the longest side of a volume.
+      int shadowResolution {64};
+
+      //! Camera pixel footprint growth per unit distance, for volume LOD.
+      float pixelSpread {0.f};
+
+      //! Number of samples each active ray takes per pass.
+      int stepsPerPass {8};
+
+      //! Trace the model's geometry first and march volumes up to the hit.
+      bool surfacesEnabled {false};
+    };
+
+  }// namespace cpp_renderer
+}// namespace ospray
@@ -0,0 +1,188 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "VolumeShadows.h"
+#include "../../lights/DirectionalLight.h"
+#include "ospcommon/tasking/parallel_for.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    // ShadowGrid definitions /////////////////////////////////////////////////
+
+    void ShadowGrid::build(const Volume &volume,
+                           const vec3f &toLight,
+                           int resolution)
+    {
+      bounds = volume.boundingBox;
+
+      // Keep the grid points roughly cubic, with at least two per axis.
+      const vec3f size    = max(bounds.size(), vec3f{1e-6f});
+      const float longest = reduce_max(size);
+      const vec3f points  = size * (float(std::max(resolution, 2) - 1)
+                                    / longest);
+
+      dimensions = max(vec3i{2}, vec3i{int(std::ceil(points.x)),
+                                       int(std::ceil(points.y)),
+                                       int(std::ceil(points.z))} + 1);
+
+      const vec3f spacing = size / vec3f{dimensions - 1};
+      scale = vec3f{dimensions - 1} / size;
+
+      values.assign(size_t(dimensions.x) * dimensions.y * dimensions.z, 1.f);
+
+      direction              = toLight;
+      this->resolution       = resolution;
+      volumeCommit           = volume.commitCount;
+      transferFunction       = volume.transferFunction.ptr;
+      transferFunctionCommit = transferFunction->commitCount;
+
+      const float  dir[3]     = {toLight.x, toLight.y, toLight.z};
+      const float  step[3]    = {spacing.x, spacing.y, spacing.z};
+      const int    dims[3]    = {dimensions.x, dimensions.y, dimensions.z};
+      const size_t strides[3] = {1,
+                                 size_t(dimensions.x),
+                                 size_t(dimensions.x) * dimensions.y};
+
+      // Sweep along the axis closest to the light direction: every slice then
+      // sees the slice before it within one (bounded) step.
+      int a = 0;
+      if (std::abs(dir[1]) > std::abs(dir[a])) a = 1;
+      if (std::abs(dir[2]) > std::abs(dir[a])) a = 2;
+
+      const int b = (a + 1) % 3;
+      const int c = (a + 2) % 3;
+
+      if (dir[a] == 0.f)
+        return;
+
+      // Segment from a grid point to the previous slice, towards the light;
+      // it lands at the same fractional grid offset for every point.
+      const float t       = step[a] / std::abs(dir[a]);
+      const vec3f segment = t * toLight;
+      const float offsetB = t * dir[b] / step[b];
+      const float offsetC = t * dir[c] / step[c];
+
+      // Transfer function opacities are per reference step.
+      const float stepRatio = t / volume.samplingStep;
+      const auto &tFcn      = *volume.transferFunction;
+
+      const int first = dir[a] > 0.f ? dims[a] - 1 : 0;
+      const int inc   = dir[a] > 0.f ? -1 : 1;
+
+      for (int s = 1; s < dims[a]; ++s) {
+        const int k = first + s * inc;
+
+        const float *previous = values.data() + (k - inc) * strides[a];
+        float *slice          = values.data() + k * strides[a];
+
+        tasking::parallel_for(size_t(dims[c]), [&](size_t j) {
+          for (int i = 0; i < dims[b]; ++i) {
+            int index[3];
+            index[a] = k;
+            index[b] = i;
+            index[c] = int(j);
+
+            const vec3f p = bounds.lower
+                            + vec3f{index[0], index[1], index[2]} * spacing;
+
+            // Light reaching the previous slice; points the segment leaves
+            // the grid through are unshadowed (the bounds are convex).
+            const float u = i + offsetB;
+            const float w = j + offsetC;
+
+            float incoming = 1.f;
+
+            if (u >= 0.f && u <= dims[b] - 1 && w >= 0.f && w <= dims[c] - 1) {
+              const int u0 = std::min(int(u), dims[b] - 2);
+              const int w0 = std::min(int(w), dims[c] - 2);
+              const float fu = u - u0;
+              const float fw = w - w0;
+
+              const float *v = previous + u0 * strides[b] + w0 * strides[c];
+              const size_t db = strides[b];
+              const size_t dc = strides[c];
+
+              const float v_0 = v[0]  + fu * (v[db]      - v[0]);
+              const float v_1 = v[dc] + fu * (v[db + dc] - v[dc]);
+
+              incoming = v_0 + fw * (v_1 - v_0);
+            }
+
+            // Attenuation along the segment, sampled at its midpoint.
+            const vec3f midpoint = clamp(p + 0.5f * segment,
+                                         bounds.lower, bounds.upper);
+            const float opacity  =
+                tFcn.lookup(volume.computeSample(midpoint)).w;
+
+            slice[i * strides[b] + j * strides[c]] =
+                incoming * powf(1.f - clamp(opacity), stepRatio);
+          }
+        });
+      }
+    }
+
+    // VolumeShadows definitions //////////////////////////////////////////////
+
+    void VolumeShadows::update(const std::vector<Volume*> &volumes,
+                               const std::vector<Light*> &lights,
+                               int resolution)
+    {
+      std::vector<VolumeEntry> updated;
+
+      for (const auto *volume : volumes) {
+        VolumeEntry entry {volume, {}};
+
+        // Reuse the grids built for this volume in previous frames.
+        for (auto &previous : entries) {
+          if (previous.volume == volume)
+            entry.grids = std::move(previous.grids);
+        }
+
+        entry.grids.resize(lights.size());
+
+        for (size_t l = 0; l < lights.size(); ++l) {
+          auto &grid = entry.grids[l];
+          auto *light = dynamic_cast<const DirectionalLight*>(lights[l]);
+
+          if (light == nullptr) {
+            grid = ShadowGrid{};
+            continue;
+          }
+
+          const vec3f toLight = light->getDirection();
+          const auto *tFcn    = volume->transferFunction.ptr;
+
+          const bool upToDate = !grid.values.empty()
+              && grid.direction == toLight
+              && grid.resolution == resolution
+              && grid.volumeCommit == volume->commitCount
+              && grid.transferFunction == tFcn
+              && grid.transferFunctionCommit == tFcn->commitCount;
+
+          if (!upToDate)
+            grid.build(*volume, toLight, resolution);
+        }
+
+        updated.push_back(std::move(entry));
+      }
+
+      entries = std::move(updated);
+    }
+
+  }// namespace cpp_renderer
+}// namespace ospray
@@ -0,0 +1,136 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "../../volume/Volume.h"
+#include "../../lights/Light.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Transmittance of a volume towards a directional light, tabulated on a
+        low resolution grid over the volume's bounds. It is built by sweeping
+        slices of the grid away from the light, each one attenuating the
+        (interpolated) transmittance of the slice before it, so shading a
+        sample is a lookup rather than a march towards the light. */
+    struct ShadowGrid
+    {
+      //! Tabulate the transmittance of 'volume' along 'toLight' (unit length,
+      //! pointing towards the light), with 'resolution' grid points along
+      //! the longest side of the volume.
+      void build(const Volume &volume, const vec3f &toLight, int resolution);
+
+      //! Trilinearly interpolated transmittance (1 outside the grid).
+      float transmittance(const vec3f &worldCoordinates) const;
+
+      // Data //
+
+      vec3i dimensions {0};
+      box3f bounds;
+
+      //! Grid points per world space unit, along each axis.
+      vec3f scale {0.f};
+
+      std::vector<float> values;
+
+      //! State the grid was built for, to detect when it is out of date.
+      vec3f  direction {0.f};
+      int    resolution {0};
+      size_t volumeCommit {0};
+      size_t transferFunctionCommit {0};
+      const TransferFunction *transferFunction {nullptr};
+    };
+
+    /*! Shadow grids of a renderer's volumes, one per volume and light (empty
+        for lights other than DirectionalLights). */
+    struct VolumeShadows
+    {
+      //! Rebuild the grids whose volume, transfer function or light changed
+      //! since the last update; the others are kept.
+      void update(const std::vector<Volume*> &volumes,
+                  const std::vector<Light*> &lights,
+                  int resolution);
+
+      //! Transmittance from the given point of 'volume' towards light 'light'
+      //! (an index into the lights passed to update()).
+      float transmittance(const Volume &volume,
+                          size_t light,
+                          const vec3f &worldCoordinates) const;
+
+    private:
+
+      struct VolumeEntry
+      {
+        const Volume *volume;
+        std::vector<ShadowGrid> grids;
+      };
+
+      std::vector<VolumeEntry> entries;
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline float ShadowGrid::transmittance(const vec3f &worldCoordinates) const
+    {
+      if (values.empty())
+        return 1.f;
+
+      const vec3f local = (worldCoordinates - bounds.lower) * scale;
+      const vec3f upper = vec3f{dimensions - 1};
+
+      if (local.x < 0.f || local.y < 0.f || local.z < 0.f ||
+          local.x > upper.x || local.y > upper.y || local.z > upper.z) {
+        return 1.f;
+      }
+
+      // Lower corner of the cell holding the point, and the fractional
+      // position inside it.
+      const vec3i i0 = min(vec3i{int(local.x), int(local.y), int(local.z)},
+                           dimensions - 2);
+      const vec3f f  = local - vec3f{i0.x, i0.y, i0.z};
+
+      const size_t dy = dimensions.x;
+      const size_t dz = dy * dimensions.y;
+
+      const float *v = values.data() + i0.x + dy * i0.y + dz * i0.z;
+
+      const float v_00 = v[0]       + f.x * (v[1]           - v[0]);
+      const float v_01 = v[dy]      + f.x * (v[dy + 1]      - v[dy]);
+      const float v_10 = v[dz]      + f.x * (v[dz + 1]      - v[dz]);
+      const float v_11 = v[dy + dz] + f.x * (v[dy + dz + 1] - v[dy + dz]);
+      const float v_0  = v_00 + f.y * (v_01 - v_00);
+      const float v_1  = v_10 + f.y * (v_11 - v_10);
+
+      return v_0 + f.z * (v_1 - v_0);
+    }
+
+    inline float VolumeShadows::transmittance(const Volume &volume,
+                                              size_t light,
+                                              const vec3f &worldCoordinates)
+                                              const
+    {
+      for (const auto &entry : entries) {
+        if (entry.volume == &volume)
+          return entry.grids[light].transmittance(worldCoordinates);
+      }
+
+      return 1.f;
+    }
+
+  }// namespace cpp_renderer
+}// namespace ospray
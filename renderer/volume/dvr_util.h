@@ -0,0 +1,387 @@
+// ======================================================================== //
+// Copyright 2009-2015 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "../../volume/Volume.h"
+#include "../../lights/AmbientLight.h"
+#include "VolumeShadows.h"
+#include "common/Data.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    // DVR helper functions ///////////////////////////////////////////////////
+
+    //! Lights shading the samples of gradient shaded volumes.
+    struct DVRLighting
+    {
+      std::vector<Light*> lights;
+
+      //! Summed radiance of the ambient lights.
+      vec3f ambient {0.f};
+
+      //! Transmittance grids of the volumes towards 'lights' (unshadowed if
+      //! null).
+      const VolumeShadows *shadows {nullptr};
+    };
+
+    //! Split the renderer's "lights" into ambient radiance and other lights.
+    inline DVRLighting getDVRLighting(Data *lightData)
+    {
+      DVRLighting lighting;
+
+      if (lightData) {
+        auto **lightArray = (cpp_renderer::Light**)lightData->data;
+        for (uint32_t i = 0; i < lightData->size(); i++) {
+          auto *light   = lightArray[i];
+          auto *ambient = dynamic_cast<cpp_renderer::AmbientLight *>(light);
+          if (ambient)
+            lighting.ambient += ambient->getRadiance();
+          else
+            lighting.lights.push_back(light);
+        }
+      }
+
+      return lighting;
+    }
+
+    /*! Diffuse plus Phong specular shading of a point 'P' with normal 'N',
+        seen along 'V', by 'lighting' (both hemispheres are lit). 'Kd' and
+        'Ks' are normalized here, as in the scivis renderer. Points inside
+        'shadowingVolume' are shadowed by it, if the lighting has shadows. */
+    inline vec3f shadeLights(const DVRLighting &lighting,
+                             const vec3f &P,
+                             const vec3f &N,
+                             const vec3f &V,
+                             const vec3f &Kd,
+                             const vec3f &Ks,
+                             float Ns,
+                             const Volume *shadowingVolume = nullptr)
+    {
+      const vec3f diffuse  = Kd * static_cast<float>(one_over_pi);
+      const vec3f specular = Ks * ((Ns + 2.f)
+                             * static_cast<float>(one_over_two_pi));
+
+      DifferentialGeometry dg;
+      dg.P  = P;
+      dg.Ng = N;
+      dg.Ns = N;
+
+      const vec3f R = V - ((2.f * dot(V, N)) * N);
+
+      vec3f color = diffuse * lighting.ambient;
+
+      const bool shadowed = lighting.shadows && shadowingVolume;
+
+      for (size_t i = 0; i < lighting.lights.size(); ++i) {
+        const auto light = lighting.lights[i]->sample(dg, vec2f{0.5f});
+
+        const float cosNL = ospcommon::abs(dot(light.dir, N));
+        const float cosLR = ospcommon::max(0.f, dot(light.dir, R));
+
+        const float transmittance = shadowed ?
+            lighting.shadows->transmittance(*shadowingVolume, i, P) : 1.f;
+
+        color += (diffuse * cosNL + specular * powf(cosLR, Ns))
+                 * light.weight * transmittance;
+      }
+
+      return color;
+    }
+
+    /*! Shade the color of a volume sample as a surface oriented along the
+        volume's gradient; without lights it is lit by a headlight. With
+        shadows, the volume shades its own samples. */
+    inline vec3f shadeVolumeSample(const Volume &volume,
+                                   const DVRLighting &lighting,
+                                   const vec3f &samplePoint,
+                                   const vec3f &rayDir,
+                                   const vec3f &sampleColor)
+    {
+      const vec3f N = volume.computeShadingNormal(samplePoint);
+
+      // Homogeneous regions have no orientation to shade.
+      if (N.x == 0.f && N.y == 0.f && N.z == 0.f)
+        return sampleColor;
+
+      const vec3f V = normalize(rayDir);
+
+      if (lighting.lights.empty())
+        return (0.2f + 0.8f * ospcommon::abs(dot(N, V))) * sampleColor;
+
+      // Volumes have no shininess parameter, a fixed one is used.
+      return shadeLights(lighting, samplePoint, N, V,
+                         sampleColor, volume.specular, 20.f, &volume);
+    }
+
+    //! Compositing state of a single ray marching through a volume.
+    struct DVRRayState
+    {
+      vec3f color {0.f};
+      float opacity {0.f};
+
+      //! Value of the last composited sample, for pre-integrated segments.
+      float lastSample {0.f};
+      bool  firstSample {true};
+
+      //! Size of the step which reached the sample at 'ray.t0' (0 before the
+      //! first step), for adaptive sampling.
+      float lastStep {0.f};
+
+      //! Growth of the ray's footprint per unit distance, used to select the
+      //! volume's resolution level (0 always samples full resolution).
+      float pixelSpread {0.f};
+
+      //! Lights for gradient shading (unshaded if null).
+      const DVRLighting *lighting {nullptr};
+    };
+
+    /*! Take the sample at 'ray.t0', composite it into 'state' and advance the
+        ray. Returns false once the ray has left the volume or saturated. */
+    inline bool integrateVolumeSample(const Volume &volume,
+                                      Ray &ray,
+                                      DVRRayState &state)
+    {
+      const auto &tFcn = *volume.transferFunction;
+
+      auto samplePoint = ray.org + ray.t0 * ray.dir;
+
+      float stepScale = 1.f;
+      float volumeSample;
+
+      if (state.pixelSpread > 0.f) {
+        // Coarser levels are sampled with proportionally longer steps.
+        const float footprint = state.pixelSpread * ray.t0;
+        stepScale    = float(1 << volume.levelOfDetail(footprint));
+        volumeSample = volume.computeSampleLOD(samplePoint, footprint);
+      } else {
+        volumeSample = volume.computeSample(samplePoint);
+      }
+
+      const auto offsetStepSize =
+          stepScale * (volume.samplingStep / volume.samplingRate);
+
+      if (state.firstSample) {
+        state.lastSample  = volumeSample;
+        state.firstSample = false;
+      }
+
+      const auto colorOpacity = volume.preIntegrationEnabled ?
+          tFcn.lookupIntegrated(state.lastSample, volumeSample) :
+          tFcn.lookup(volumeSample);
+
+      vec3f sampleColor {colorOpacity.x, colorOpacity.y, colorOpacity.z};
+      float sampleOpacity = colorOpacity.w;
+
+      if (volume.gradientShadingEnabled && state.lighting &&
+          sampleOpacity > 0.f) {
+        sampleColor = shadeVolumeSample(volume, *state.lighting,
+                                        samplePoint, ray.dir, sampleColor);
+      }
+
+      float clampedOpacity;
+
+      if (volume.adaptiveSamplingEnabled) {
+        // Correct the opacity for the length of the step which reached this
+        // sample, relative to the volume's reference step.
+        const float sampleStep =
+            (state.lastStep > 0.f) ? state.lastStep : offsetStepSize;
+        if (!volume.advanceAdaptive(ray, state.lastStep,
+                                    sampleOpacity, stepScale))
+          return ray.t0 < ray.t;
+
+        clampedOpacity = 1.f - powf(1.f - clamp(sampleOpacity),
+                                    sampleStep / volume.samplingStep);
+      } else {
+        clampedOpacity = clamp(sampleOpacity * stepScale / volume.samplingRate);
+        volume.advance(ray, stepScale);
+      }
+
+      state.lastSample = volumeSample;
+
+      sampleColor *= clampedOpacity;
+
+      state.color   += (1.f - state.opacity) * sampleColor;
+      state.opacity += (1.f - state.opacity) * clampedOpacity;
+
+      return ray.t0 < ray.t && state.opacity < 0.99f;
+    }
+
+    /*! Clip the ray to the first of the volume's isosurfaces in [ray.t0,
+        ray.t], if it hits one; the hit is left in 'ray.primID' and 'ray.Ng'
+        for shading. Callers bound 'ray.t' by any surface hit first. */
+    inline bool intersectIsosurfaces(const Volume &volume, Ray &ray)
+    {
+      if (volume.isovalues.empty())
+        return false;
+
+      // Crossings behind 'ray.t' (e.g. an opaque surface) are hidden.
+      const float tMax = ray.t;
+
+      ray.primID = RTC_INVALID_GEOMETRY_ID;
+      volume.intersectIsosurface(volume.isovalues, ray);
+
+      if (ray.primID == static_cast<int>(RTC_INVALID_GEOMETRY_ID))
+        return false;
+
+      if (ray.t > tMax) {
+        ray.t      = tMax;
+        ray.primID = RTC_INVALID_GEOMETRY_ID;
+        return false;
+      }
+
+      return true;
+    }
+
+    //! Composite an isosurface hit (opaque) behind the integrated volume.
+    inline void compositeIsosurface(const Volume &volume,
+                                    const Ray &ray,
+                                    DVRRayState &state)
+    {
+      const auto &tFcn = *volume.transferFunction;
+
+      const vec4f colorOpacity = tFcn.lookup(volume.isovalues[ray.primID]);
+      const vec3f N = ray.Ng;
+
+      const float lenN = length(N);
+      const float c = (lenN > 0.f) ?
+          0.2f + 0.8f * ospcommon::abs(dot(N / lenN, normalize(ray.dir))) :
+          1.f;
+
+      const vec3f surfaceColor =
+          c * vec3f{colorOpacity.x, colorOpacity.y, colorOpacity.z};
+
+      state.color  += (1.f - state.opacity) * surfaceColor;
+      state.opacity = 1.f;
+    }
+
+    /*! Composite a surface hit behind the integrated volume; the surface
+        ends the ray, so its opacity 'd' blends it with the background. */
+    inline void compositeSurface(const DVRLighting &lighting,
+                                 const DifferentialGeometry &dg,
+                                 const Ray &ray,
+                                 const vec3f &Kd,
+                                 const vec3f &Ks,
+                                 float Ns,
+                                 float d,
+                                 DVRRayState &state)
+    {
+      const vec3f V = normalize(ray.dir);
+
+      const vec3f surfaceColor = lighting.lights.empty() ?
+          (0.2f + 0.8f * ospcommon::abs(dot(dg.Ns, V))) * Kd :
+          shadeLights(lighting, dg.P, dg.Ns, V, Kd, Ks, Ns);
+
+      state.color   += (1.f - state.opacity) * d * surfaceColor;
+      state.opacity += (1.f - state.opacity) * d;
+    }
+
+    //! A ray's interval through one of several volumes, marched on its own.
+    struct DVRVolumeInterval
+    {
+      const Volume *volume;
+      Ray ray;
+      DVRRayState state;
+      bool hitIsosurface;
+      bool marching;
+    };
+
+    /*! Integrate all 'volumes' along 'ray' front to back. Each volume is
+        marched by its own copy of the ray, and the next sample is always the
+        nearest pending one of any volume, so overlapping intervals interleave
+        and disjoint ones are visited in order of entry. The nearest isosurface
+        of any volume ends all intervals and is composited behind them; no
+        interval extends past 'ray.t'.
+        'jitter' in [0, 1) offsets the first sample of each volume by a
+        fraction of its step; 'intervals' is scratch space. */
+    inline void integrateVolumes(const std::vector<Volume*> &volumes,
+                                 const Ray &ray,
+                                 float jitter,
+                                 DVRRayState &state,
+                                 std::vector<DVRVolumeInterval> &intervals)
+    {
+      intervals.clear();
+
+      const DVRVolumeInterval *isosurfaceHit = nullptr;
+
+      for (const auto *volume : volumes) {
+        DVRVolumeInterval interval {volume, ray, state, false, false};
+
+        if (!volume->intersect(interval.ray))
+          continue;
+
+        // Surfaces traced before the march end the interval at 'ray.t'.
+        interval.ray.t = ospcommon::min(interval.ray.t, ray.t);
+
+        interval.hitIsosurface = intersectIsosurfaces(*volume, interval.ray);
+
+        intervals.push_back(interval);
+      }
+
+      // Only the nearest isosurface is visible, and it ends every interval.
+      float tEnd = inf;
+
+      for (const auto &interval : intervals) {
+        if (interval.hitIsosurface && interval.ray.t < tEnd) {
+          tEnd = interval.ray.t;
+          isosurfaceHit = &interval;
+        }
+      }
+
+      for (auto &interval : intervals) {
+        auto &r = interval.ray;
+        const auto &volume = *interval.volume;
+
+        r.t     = ospcommon::min(r.t, tEnd);
+        r.t0   += jitter * (volume.samplingStep / volume.samplingRate);
+
+        interval.state.lastStep = 0.f;
+
+        interval.marching = r.t0 < r.t;
+      }
+
+      while (state.opacity < 0.99f) {
+        DVRVolumeInterval *next = nullptr;
+
+        for (auto &interval : intervals) {
+          if (interval.marching &&
+              (next == nullptr || interval.ray.t0 < next->ray.t0)) {
+            next = &interval;
+          }
+        }
+
+        if (next == nullptr)
+          break;
+
+        // Composite into the state shared by all volumes.
+        next->state.color   = state.color;
+        next->state.opacity = state.opacity;
+
+        next->marching = integrateVolumeSample(*next->volume,
+                                               next->ray,
+                                               next->state);
+
+        state.color   = next->state.color;
+        state.opacity = next->state.opacity;
+      }
+
+      if (isosurfaceHit)
+        compositeIsosurface(*isosurfaceHit->volume, isosurfaceHit->ray, state);
+    }
+
+  }// namespace cpp_renderer
+}// namespace ospray
@@ -40,7 +40,7 @@ namespace ospray {
         memcpy(opacityValues.data(), opacityData->data, opacityData->numBytes);
       }
 
-      preIntegrationEnabled = getParam1i("preIntegration", 0);
+      buildOpacityRangeTable();
 
       TransferFunction::commit();
     }
@@ -83,7 +83,8 @@ namespace ospray {
     vec3f LinearTransferFunction::integratedColor(float value1,
                                                   float value2) const
     {
-      NOT_IMPLEMENTED
+      const vec4f colorOpacity = lookupIntegrated(value1, value2);
+      return vec3f{colorOpacity.x, colorOpacity.y, colorOpacity.z};
     }
 
     float LinearTransferFunction::opacity(float value) const
@@ -119,17 +120,85 @@ namespace ospray {
     float LinearTransferFunction::integratedOpacity(float value1,
                                                     float value2) const
     {
-      NOT_IMPLEMENTED
+      return lookupIntegrated(value1, value2).w;
     }
 
     float LinearTransferFunction::maxOpacity(const vec2f &range) const
     {
-      NOT_IMPLEMENTED
+      return minMaxOpacity(range).y;
     }
 
     vec2f LinearTransferFunction::minMaxOpacity(const vec2f &range) const
     {
-      NOT_IMPLEMENTED
+      if (opacityValues.empty())
+        return vec2f{1.0f};
+
+      const int numOpacities = static_cast<int>(opacityValues.size());
+
+      // The extremes of a piecewise linear function over an interval are
+      // either at the interval ends or at control points inside of it.
+      const float lowerOpacity = opacity(range.x);
+      const float upperOpacity = opacity(range.y);
+
+      vec2f result {ospcommon::min(lowerOpacity, upperOpacity),
+                    ospcommon::max(lowerOpacity, upperOpacity)};
+
+      auto remap = [&](float value) {
+        return clamp((value - valueRange.x)
+                     / (valueRange.y - valueRange.x)
+                     * (numOpacities - 1.0f),
+                     0.0f, numOpacities - 1.0f);
+      };
+
+      const int first = static_cast<int>(ceilf(remap(range.x)));
+      const int last  = static_cast<int>(floorf(remap(range.y)));
+
+      if (first <= last) {
+        const vec2f inner = opacityRange(first, last);
+        result.x = ospcommon::min(result.x, inner.x);
+        result.y = ospcommon::max(result.y, inner.y);
+      }
+
+      return result;
+    }
+
+    void LinearTransferFunction::buildOpacityRangeTable()
+    {
+      opacityRangeTable.clear();
+
+      const int numOpacities = static_cast<int>(opacityValues.size());
+
+      if (numOpacities == 0)
+        return;
+
+      std::vector<vec2f> level(numOpacities);
+      for (int i = 0; i < numOpacities; ++i)
+        level[i] = vec2f{opacityValues[i]};
+
+      opacityRangeTable.push_back(std::move(level));
+
+      for (int width = 2; width <= numOpacities; width *= 2) {
+        const auto &prev = opacityRangeTable.back();
+        const int half   = width / 2;
+
+        level.resize(numOpacities - width + 1);
+        for (size_t i = 0; i < level.size(); ++i) {
+          level[i] = vec2f{ospcommon::min(prev[i].x, prev[i + half].x),
+                           ospcommon::max(prev[i].y, prev[i + half].y)};
+        }
+
+        opacityRangeTable.push_back(std::move(level));
+      }
+    }
+
+    vec2f LinearTransferFunction::opacityRange(int first, int last) const
+    {
+      // Cover [first, last] with two (possibly overlapping) power-of-two runs.
+      const int k = std::ilogb(float(last - first + 1));
+      const auto &level = opacityRangeTable[k];
+      const vec2f &a = level[first];
+      const vec2f &b = level[last - (1 << k) + 1];
+      return vec2f{ospcommon::min(a.x, b.x), ospcommon::max(a.y, b.y)};
     }
 
     // A piecewise linear transfer function.
@@ -43,12 +43,19 @@ namespace ospray {
       virtual float maxOpacity(const vec2f &range) const override;
       virtual vec2f minMaxOpacity(const vec2f &range) const override;
 
+      // Helper functions //
+
+      void  buildOpacityRangeTable();
+      vec2f opacityRange(int first, int last) const;
+
       // Data members //
 
       std::vector<vec3f> colorValues;
       std::vector<float> opacityValues;
 
-      bool preIntegrationEnabled {false};
+      //! Sparse table over 'opacityValues': level k holds the opacity range
+      //! (min, max) of the control points [i, i + 2^k).
+      std::vector<std::vector<vec2f>> opacityRangeTable;
     };
 
   } // ::ospray::cpp_renderer
@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "TransferFunction.h"
+#include "ospcommon/tasking/parallel_for.h"
 
 namespace ospray {
   namespace cpp_renderer {
@@ -22,6 +23,32 @@ namespace ospray {
     void TransferFunction::commit()
     {
       valueRange = getParam2f("valueRange", vec2f(0.0f, 1.0f));
+      buildLookupTable(getParam1i("lookupTableSize", 1024));
+
+      preIntegrationEnabled = getParam1i("preIntegration", 0);
+
+      if (preIntegrationEnabled || !preIntegrationUsers.empty())
+        buildPreIntegrationTable(getParam1i("preIntegrationTableSize", 256));
+      else
+        preIntegrationTable.clear();
+
+      ++commitCount;
+    }
+
+    void TransferFunction::requirePreIntegration(const void *volume,
+                                                 bool required)
+    {
+      if (required) {
+        preIntegrationUsers.insert(volume);
+
+        if (preIntegrationTable.empty())
+          buildPreIntegrationTable(getParam1i("preIntegrationTableSize", 256));
+      } else {
+        preIntegrationUsers.erase(volume);
+
+        if (preIntegrationUsers.empty() && !preIntegrationEnabled)
+          preIntegrationTable.clear();
+      }
     }
 
     std::string TransferFunction::toString() const
@@ -29,6 +56,85 @@ namespace ospray {
       return "ospray::cpp_renderer::TransferFunction";
     }
 
+    void TransferFunction::buildLookupTable(int size)
+    {
+      size = std::max(size, 1);
+
+      lookupTable.resize(size);
+
+      const float range = valueRange.y - valueRange.x;
+      const float width = range / size;
+
+      // Entry 'i' covers [lower + i*width, lower + (i+1)*width) and holds the
+      // transfer function's value at the center of that interval.
+      for (int i = 0; i < size; ++i) {
+        const float value = valueRange.x + (i + 0.5f) * width;
+        const vec3f c     = color(value);
+        lookupTable[i]    = vec4f{c.x, c.y, c.z, opacity(value)};
+      }
+
+      lookupScale  = (range > 0.f) ? size / range : 0.f;
+      lookupOffset = -valueRange.x * lookupScale;
+    }
+
+    void TransferFunction::buildPreIntegrationTable(int size)
+    {
+      size = std::max(size, 2);
+
+      const float range = valueRange.y - valueRange.x;
+      const float width = range / (size - 1);
+
+      // Per-value extinction (derived from the per-step opacity) and its
+      // running integrals, alone and weighted by color, along the value axis.
+      std::vector<float> extinction(size);
+      std::vector<vec3f> colors(size);
+      std::vector<float> extinctionIntegral(size, 0.f);
+      std::vector<vec3f> colorIntegral(size, vec3f{0.f});
+
+      for (int i = 0; i < size; ++i) {
+        const float value = valueRange.x + i * width;
+        const float alpha = ospcommon::min(opacity(value), 0.9999f);
+        extinction[i] = -logf(1.f - alpha);
+        colors[i]     = color(value);
+
+        if (i > 0) {
+          extinctionIntegral[i] = extinctionIntegral[i-1]
+                                  + 0.5f * (extinction[i-1] + extinction[i]);
+          colorIntegral[i] = colorIntegral[i-1]
+                             + 0.5f * (colors[i-1] * extinction[i-1]
+                                       + colors[i] * extinction[i]);
+        }
+      }
+
+      preIntegrationTable.resize(size_t(size) * size);
+
+      tasking::parallel_for(size_t(size), [&](size_t front) {
+        for (int back = 0; back < size; ++back) {
+          float tau   = extinction[front];
+          vec3f color = colors[front];
+
+          if (back != int(front)) {
+            // Linear variation of the value along the segment: average the
+            // extinction over the value interval, and weight color by it.
+            const float dv = ospcommon::abs(float(back) - float(front));
+            const float T  = extinctionIntegral[back]
+                             - extinctionIntegral[front];
+            tau = ospcommon::abs(T) / dv;
+            color = (T != 0.f)
+                    ? (colorIntegral[back] - colorIntegral[front]) / T
+                    : 0.5f * (colors[front] + colors[back]);
+          }
+
+          preIntegrationTable[front * size + back] =
+              vec4f{color.x, color.y, color.z, 1.f - expf(-tau)};
+        }
+      });
+
+      preIntegrationSize   = size;
+      preIntegrationScale  = (range > 0.f) ? (size - 1) / range : 0.f;
+      preIntegrationOffset = -valueRange.x * preIntegrationScale;
+    }
+
   } // ::ospray::cpp_renderer
 } // ::ospray
 
@@ -18,6 +18,11 @@
 
 #include "transferFunction/TransferFunction.h"
 
+#include "../common/simd.h"
+// std
+#include <cmath>
+#include <set>
+
 namespace ospray {
   namespace cpp_renderer {
 
@@ -39,10 +44,175 @@ namespace ospray {
       virtual float maxOpacity(const vec2f &range) const = 0;
       virtual vec2f minMaxOpacity(const vec2f &range) const = 0;
 
+      // Lookup table interface //
+
+      //! Color (xyz) and opacity (w) from the precomputed lookup table, using
+      //! the nearest table entry (NaN values are black and transparent, as
+      //! with color() and opacity()).
+      vec4f lookup(float value) const;
+      simd::vec4f lookup(const simd::vfloat &value) const;
+
+      //! Color (xyz) and opacity (w) of the segment between a front and a back
+      //! sample one reference step apart, from the pre-integration table.
+      vec4f lookupIntegrated(float front, float back) const;
+      simd::vec4f lookupIntegrated(const simd::vfloat &front,
+                                   const simd::vfloat &back) const;
+
+      //! Register whether 'volume' samples the pre-integration table; it is
+      //! kept up to date while any volume (or "preIntegration") needs it.
+      void requirePreIntegration(const void *volume, bool required);
+
       // Data members //
 
       vec2f valueRange {0.f, 1.f};
+
+      bool preIntegrationEnabled {false};
+
+      //! Incremented by every commit, so data derived from the transfer
+      //! function can tell when it is out of date.
+      size_t commitCount {0};
+
+    protected:
+
+      //! Tabulate color() and opacity() across 'valueRange'; must be called
+      //! once the derived class has committed its own parameters.
+      void buildLookupTable(int size);
+
+      //! Gather the entries at 'index' of a table, one component at a time.
+      static simd::vec4f gatherEntries(const std::vector<vec4f> &table,
+                                       const simd::vint &index);
+
+      std::vector<vec4f> lookupTable;
+
+      //! Maps a value to a (fractional) lookup table index: value*scale+offset
+      float lookupScale  {0.f};
+      float lookupOffset {0.f};
+
+      //! Tabulate the segment integrals of color() and opacity() for all
+      //! pairs of 'size' values spanning 'valueRange', in parallel.
+      void buildPreIntegrationTable(int size);
+
+      //! Row-major [front][back] table of integrated color and opacity.
+      std::vector<vec4f> preIntegrationTable;
+
+      //! The volumes sampling the pre-integration table.
+      std::set<const void *> preIntegrationUsers;
+
+      int   preIntegrationSize   {0};
+      float preIntegrationScale  {0.f};
+      float preIntegrationOffset {0.f};
     };
 
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline vec4f TransferFunction::lookup(float value) const
+    {
+      if (std::isnan(value))
+        return vec4f{0.f};
+
+      const float maxIndex = lookupTable.size() - 1;
+      const float index    = std::max(0.f, std::min(value * lookupScale
+                                                    + lookupOffset, maxIndex));
+      return lookupTable[static_cast<int>(index)];
+    }
+
+    inline simd::vec4f TransferFunction::lookup(const simd::vfloat &value) const
+    {
+      const float maxIndex = lookupTable.size() - 1;
+
+      // NaN fails every comparison, so the clamps still give it a valid
+      // index; its entry is made transparent below.
+      const auto isNaN = !(value == value);
+
+      simd::vfloat indexf = value * lookupScale + lookupOffset;
+      indexf = simd::select(indexf < maxIndex, indexf, maxIndex);
+      indexf = simd::select(indexf > 0.f, indexf, 0.f);
+
+      simd::vec4f result =
+          gatherEntries(lookupTable, simd::cast<simd::vint>(indexf));
+
+      result.x = simd::select(isNaN, 0.f, result.x);
+      result.y = simd::select(isNaN, 0.f, result.y);
+      result.z = simd::select(isNaN, 0.f, result.z);
+      result.w = simd::select(isNaN, 0.f, result.w);
+
+      return result;
+    }
+
+    inline vec4f TransferFunction::lookupIntegrated(float front,
+                                                    float back) const
+    {
+      if (preIntegrationTable.empty())
+        return lookup(0.5f * (front + back));
+
+      // Segments reaching outside of the data are transparent, as in lookup().
+      if (std::isnan(front) || std::isnan(back))
+        return vec4f{0.f};
+
+      const float maxIndex = preIntegrationSize - 1;
+
+      auto index = [&](float value) {
+        const float indexf = std::max(0.f,
+                                      std::min(value * preIntegrationScale
+                                               + preIntegrationOffset,
+                                               maxIndex));
+        return static_cast<int>(indexf + 0.5f);
+      };
+
+      return preIntegrationTable[index(front) * preIntegrationSize
+                                 + index(back)];
+    }
+
+    inline simd::vec4f
+    TransferFunction::lookupIntegrated(const simd::vfloat &front,
+                                       const simd::vfloat &back) const
+    {
+      if (preIntegrationTable.empty())
+        return lookup(0.5f * (front + back));
+
+      const auto isNaN = !(front == front) | !(back == back);
+
+      const float maxIndex = preIntegrationSize - 1;
+
+      auto index = [&](const simd::vfloat &value) {
+        simd::vfloat indexf = value * preIntegrationScale
+                              + preIntegrationOffset;
+        indexf = simd::select(indexf < maxIndex, indexf, maxIndex);
+        indexf = simd::select(indexf > 0.f, indexf, 0.f);
+        return simd::cast<simd::vint>(indexf + 0.5f);
+      };
+
+      simd::vec4f result =
+          gatherEntries(preIntegrationTable,
+                        index(front) * preIntegrationSize + index(back));
+
+      result.x = simd::select(isNaN, 0.f, result.x);
+      result.y = simd::select(isNaN, 0.f, result.y);
+      result.z = simd::select(isNaN, 0.f, result.z);
+      result.w = simd::select(isNaN, 0.f, result.w);
+
+      return result;
+    }
+
+    inline simd::vec4f
+    TransferFunction::gatherEntries(const std::vector<vec4f> &table,
+                                    const simd::vint &index)
+    {
+      // Entries are four packed floats, so component c of entry i is float
+      // 4*i+c of the table.
+      static_assert(sizeof(vec4f) == 4 * sizeof(float),
+                    "lookup table entries must be packed");
+
+      const float *entries = &table[0].x;
+      const simd::vint offset = index * 4;
+
+      simd::vec4f result;
+      result.x = simd::gather<simd::vfloat>(entries, offset);
+      result.y = simd::gather<simd::vfloat>(entries, offset + 1);
+      result.z = simd::gather<simd::vfloat>(entries, offset + 2);
+      result.w = simd::gather<simd::vfloat>(entries, offset + 3);
+      return result;
+    }
+
   } // ::ospray::cpp_renderer
 } // ::ospray
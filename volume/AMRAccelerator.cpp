@@ -0,0 +1,148 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "AMRAccelerator.h"
+// std
+#include <algorithm>
+#include <numeric>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    static inline float axisValue(const vec3f &v, int axis)
+    {
+      return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+
+    void AMRAccelerator::build(const std::vector<box3f> &brickBounds,
+                               const std::vector<int> &brickLevels)
+    {
+      nodes.clear();
+
+      bounds = empty;
+      for (const auto &b : brickBounds)
+        bounds.extend(b);
+
+      std::vector<int> bricks(brickBounds.size());
+      std::iota(bricks.begin(), bricks.end(), 0);
+
+      nodes.resize(1);
+      buildRecursive(0, bounds, bricks, brickBounds, brickLevels);
+    }
+
+    void AMRAccelerator::buildRecursive(int nodeID,
+                                        const box3f &region,
+                                        const std::vector<int> &candidates,
+                                        const std::vector<box3f> &brickBounds,
+                                        const std::vector<int> &brickLevels)
+    {
+      // Bricks overlapping the region with a non-zero volume.
+      std::vector<int> bricks;
+
+      for (const int b : candidates) {
+        const vec3f lower = max(region.lower, brickBounds[b].lower);
+        const vec3f upper = min(region.upper, brickBounds[b].upper);
+        if (lower.x < upper.x && lower.y < upper.y && lower.z < upper.z) {
+          bricks.push_back(b);
+        }
+      }
+
+      if (bricks.empty()) {
+        nodes[nodeID] = Node{};
+        return;
+      }
+
+      const int finest = *std::max_element(bricks.begin(), bricks.end(),
+                                           [&](int a, int b) {
+                                             return brickLevels[a] <
+                                                    brickLevels[b];
+                                           });
+
+      const box3f &finestBounds = brickBounds[finest];
+
+      // Bricks of one level do not overlap, so a region covered by the
+      // finest brick overlapping it has no finer data anywhere inside.
+      if (finestBounds.lower.x <= region.lower.x &&
+          finestBounds.lower.y <= region.lower.y &&
+          finestBounds.lower.z <= region.lower.z &&
+          finestBounds.upper.x >= region.upper.x &&
+          finestBounds.upper.y >= region.upper.y &&
+          finestBounds.upper.z >= region.upper.z) {
+        nodes[nodeID] = Node{0.f, 3, finest};
+        return;
+      }
+
+      // Split at the brick face strictly inside of the region which is
+      // closest to its center, relative to the region's size on that axis.
+      // The finest brick has such a face, and the children have fewer.
+      const vec3f center = region.center();
+      const vec3f size   = region.size();
+
+      int   splitAxis = -1;
+      float split     = 0.f;
+      float bestScore = inf;
+
+      auto consider = [&](int axis, float coordinate) {
+        const float lower = axisValue(region.lower, axis);
+        const float upper = axisValue(region.upper, axis);
+
+        if (coordinate <= lower || coordinate >= upper)
+          return;
+
+        const float score = std::abs(coordinate - axisValue(center, axis))
+                            / axisValue(size, axis);
+        if (score < bestScore) {
+          bestScore = score;
+          splitAxis = axis;
+          split     = coordinate;
+        }
+      };
+
+      for (const int b : bricks) {
+        for (int axis = 0; axis < 3; ++axis) {
+          consider(axis, axisValue(brickBounds[b].lower, axis));
+          consider(axis, axisValue(brickBounds[b].upper, axis));
+        }
+      }
+
+      // Only reachable for degenerate (e.g. NaN) bounds.
+      if (splitAxis < 0) {
+        nodes[nodeID] = Node{0.f, 3, finest};
+        return;
+      }
+
+      box3f lowerRegion = region;
+      box3f upperRegion = region;
+
+      switch (splitAxis) {
+      case 0: lowerRegion.upper.x = upperRegion.lower.x = split; break;
+      case 1: lowerRegion.upper.y = upperRegion.lower.y = split; break;
+      default: lowerRegion.upper.z = upperRegion.lower.z = split; break;
+      }
+
+      const int children = nodes.size();
+      nodes.resize(children + 2);
+
+      nodes[nodeID] = Node{split, splitAxis, children};
+
+      buildRecursive(children, lowerRegion, bricks, brickBounds, brickLevels);
+      buildRecursive(children + 1, upperRegion, bricks, brickBounds,
+                     brickLevels);
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+// ospray
+#include "ospray/common/OSPCommon.h"
+// std
+#include <vector>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! k-d tree over the bricks of an AMR volume, subdividing space at brick
+        faces until each leaf is covered by a single finest brick (or by
+        none), so finding the finest brick at a point is one descent. */
+    struct AMRAccelerator
+    {
+      struct Node
+      {
+        //! Inner nodes: split coordinate along 'axis', children at 'offset'
+        //! and 'offset' + 1. Leaves (axis == 3): the brick, or -1.
+        float split {0.f};
+        int   axis  {3};
+        int   offset {-1};
+      };
+
+      //! Build over bricks with the given world bounds and refinement levels
+      //! (higher levels are finer).
+      void build(const std::vector<box3f> &brickBounds,
+                 const std::vector<int> &brickLevels);
+
+      //! The finest brick containing 'point', or -1.
+      int locate(const vec3f &point) const;
+
+      // Data //
+
+      box3f bounds;
+      std::vector<Node> nodes;
+
+    private:
+
+      void buildRecursive(int nodeID,
+                          const box3f &region,
+                          const std::vector<int> &candidates,
+                          const std::vector<box3f> &brickBounds,
+                          const std::vector<int> &brickLevels);
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline int AMRAccelerator::locate(const vec3f &point) const
+    {
+      if (nodes.empty() ||
+          point.x < bounds.lower.x || point.x > bounds.upper.x ||
+          point.y < bounds.lower.y || point.y > bounds.upper.y ||
+          point.z < bounds.lower.z || point.z > bounds.upper.z) {
+        return -1;
+      }
+
+      const Node *node = &nodes[0];
+
+      while (node->axis != 3) {
+        const float coordinate = node->axis == 0 ? point.x :
+                                 (node->axis == 1 ? point.y : point.z);
+        node = &nodes[node->offset + (coordinate < node->split ? 0 : 1)];
+      }
+
+      return node->offset;
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
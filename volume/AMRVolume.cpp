@@ -0,0 +1,436 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+//ospray
+#include "AMRVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    std::string AMRVolume::toString() const
+    {
+      return "ospray::cpp_renderer::AMRVolume";
+    }
+
+    void AMRVolume::commit()
+    {
+      cpp_renderer::Volume::commit();
+
+      auto *infoData  = getParamData("brickInfo", nullptr);
+      auto *brickData  = getParamData("brickData", nullptr);
+
+      exitOnCondition(infoData == nullptr || brickData == nullptr,
+                      "AMR volumes need 'brickInfo' and 'brickData'");
+
+      const vec3f origin = getParam3f("gridOrigin", vec3f(0.f));
+
+      // The bricks and their k-d tree are only rebuilt when the arrays are
+      // replaced or moved; the values themselves are read in place.
+      if (infoData != brickInfoArray.ptr || brickData != brickDataArray.ptr ||
+          origin != gridOrigin) {
+        brickInfoArray = infoData;
+        brickDataArray = brickData;
+        gridOrigin     = origin;
+
+        gatherBricks();
+
+        std::vector<box3f> brickBounds(bricks.size());
+        std::vector<int>   brickLevels(bricks.size());
+
+        for (size_t i = 0; i < bricks.size(); ++i) {
+          brickBounds[i] = bricks[i].bounds;
+          brickLevels[i] = bricks[i].level;
+        }
+
+        accelerator.build(brickBounds, brickLevels);
+
+        boundingBox = accelerator.bounds;
+      }
+    }
+
+    int AMRVolume::setRegion(const void *source,
+                             const vec3i &index,
+                             const vec3i &count)
+    {
+      UNUSED(source, index, count);
+      return 0;
+    }
+
+    void AMRVolume::computeSamples(float **results,
+                                   const vec3f *worldCoordinates,
+                                   const size_t &count)
+    {
+      *results = (float*)malloc(count * sizeof(float));
+      exitOnCondition(*results == nullptr, "error allocating memory");
+
+      float *samples = *results;
+
+      tasking::parallel_for(count, [&](size_t i) {
+        samples[i] = computeSample(worldCoordinates[i]);
+      });
+    }
+
+    float AMRVolume::computeSample(const vec3f &worldCoordinates) const
+    {
+      const int brickID = accelerator.locate(worldCoordinates);
+
+      if (brickID < 0)
+        return std::numeric_limits<float>::quiet_NaN();
+
+      return sampleBrick(bricks[brickID], worldCoordinates);
+    }
+
+    vec3f AMRVolume::computeGradient(const vec3f &worldCoordinates) const
+    {
+      // Central differences at the resolution of the level sampled.
+      const float h = cellWidthAt(worldCoordinates);
+
+      const float center = computeSample(worldCoordinates);
+
+      // Samples outside of every brick are NaN; next to the boundary fall
+      // back to a one-sided difference (zero if neither neighbor exists).
+      auto derivative = [&](const vec3f &step) {
+        const float forward  = computeSample(worldCoordinates + step);
+        const float backward = computeSample(worldCoordinates - step);
+
+        if (!std::isnan(forward) && !std::isnan(backward))
+          return (forward - backward) / (2.f * h);
+        else if (!std::isnan(forward) && !std::isnan(center))
+          return (forward - center) / h;
+        else if (!std::isnan(backward) && !std::isnan(center))
+          return (center - backward) / h;
+        else
+          return 0.f;
+      };
+
+      return vec3f{derivative(vec3f{h, 0.0f, 0.0f}),
+                   derivative(vec3f{0.0f, h, 0.0f}),
+                   derivative(vec3f{0.0f, 0.0f, h})};
+    }
+
+    bool AMRVolume::intersect(Ray &ray) const
+    {
+      auto hits = intersectBox(ray, boundingBox);
+
+      if (hits.first < hits.second && hits.first < ray.t &&
+          clipInterval(ray.org, ray.dir, hits.first, hits.second)) {
+        ray.t0 = hits.first;
+        ray.t  = hits.second;
+        return true;
+      } else {
+        return false;
+      }
+    }
+
+    void AMRVolume::advance(Ray &ray, float stepScale) const
+    {
+      // The renderers correct opacity for a constant step here, so the step
+      // cannot follow the level.
+      ray.t0 += stepScale * samplingStep / samplingRate;
+    }
+
+    bool AMRVolume::advanceAdaptive(Ray &ray,
+                                    float &lastStep,
+                                    float sampleOpacity,
+                                    float stepScale) const
+    {
+      const float width = cellWidthAt(ray.org + ray.t0 * ray.dir);
+
+      const float maxRate  = ospcommon::max(samplingRate,
+                                            adaptiveMaxSamplingRate);
+      const float rate     = clamp(adaptiveScalar * sampleOpacity,
+                                   samplingRate, maxRate);
+      const float step     = stepScale * width / rate;
+
+      // A (coarse level) step which landed in an opaque feature is retaken
+      // with the finer step.
+      if (sampleOpacity > adaptiveBacktrack && lastStep > 1.25f * step) {
+        ray.t0  += step - lastStep;
+        lastStep = step;
+        return false;
+      }
+
+      ray.t0  += step;
+      lastStep = step;
+
+      return true;
+    }
+
+    void AMRVolume::intersectIsosurface(const std::vector<float> &isovalues,
+                                        Ray &ray) const
+    {
+      if (isovalues.empty())
+        return;
+
+      // Only the (clipped) interval found by intersect() is searched.
+      const float tEnd = ray.t;
+
+      if (!(ray.t0 < tEnd))
+        return;
+
+      auto pointAt = [&](float t) { return ray.org + t * ray.dir; };
+
+      float t0 = ray.t0;
+      float v0 = computeSample(pointAt(t0));
+
+      while (t0 < tEnd) {
+        const float step = cellWidthAt(pointAt(t0)) / samplingRate;
+        const float t1   = ospcommon::min(t0 + step, tEnd);
+        const float v1   = computeSample(pointAt(t1));
+
+        // Samples outside of all bricks bracket no crossing.
+        if (!std::isnan(v0) && !std::isnan(v1)) {
+          float tHit  = inf;
+          int   isoID = -1;
+
+          for (size_t i = 0; i < isovalues.size(); ++i) {
+            const float iso = isovalues[i];
+            if ((v0 < iso) != (v1 < iso)) {
+              const float tIso = refineIsosurfaceHit(ray, iso, t0, v0, t1, v1);
+              if (tIso < tHit) {
+                tHit  = tIso;
+                isoID = i;
+              }
+            }
+          }
+
+          if (isoID >= 0) {
+            ray.t      = tHit;
+            ray.primID = isoID;
+            ray.Ng     = computeGradient(pointAt(tHit));
+            return;
+          }
+        }
+
+        t0 = t1;
+        v0 = v1;
+      }
+    }
+
+    size_t AMRVolume::brickID(const vec3f &worldCoordinates) const
+    {
+      const int id = accelerator.locate(worldCoordinates);
+
+      if (id < 0)
+        return 0;
+
+      // Groups of 4^3 cells of the brick, in its (x-fastest) memory order.
+      const Brick &brick = bricks[id];
+
+      const vec3f local = clamp((worldCoordinates - brick.bounds.lower)
+                                * brick.rcpCellWidth,
+                                vec3f{0.f}, vec3f{brick.dimensions - 1});
+      const vec3i group {int(local.x) / 4, int(local.y) / 4, int(local.z) / 4};
+      const vec3i groupCount = (brick.dimensions + 3) / 4;
+
+      const size_t groupID =
+          group.x + groupCount.x * (group.y + size_t(groupCount.y) * group.z);
+
+      return (size_t(id + 1) << 32) | groupID;
+    }
+
+    // SIMD interface /////////////////////////////////////////////////////////
+
+    simd::vfloat
+    AMRVolume::computeSample(simd::vmaski active,
+                             const simd::vec3f &worldCoordinates) const
+    {
+      simd::vfloat samples {0.f};
+
+      simd::foreach_active(active, [&](int i) {
+        samples[i] = computeSample(vec3f{worldCoordinates.x[i],
+                                         worldCoordinates.y[i],
+                                         worldCoordinates.z[i]});
+      });
+
+      return samples;
+    }
+
+    simd::vmaski AMRVolume::intersect(simd::vmaski active, RayN &ray) const
+    {
+      auto hits = intersectBox(ray, boundingBox);
+
+      auto hit = active & (hits.first < hits.second) & (hits.first < ray.t);
+      hit = clipInterval(hit, ray.org, ray.dir, hits.first, hits.second);
+
+      ray.t0 = simd::select(hit, hits.first, ray.t0);
+      ray.t  = simd::select(hit, hits.second, ray.t);
+
+      return hit;
+    }
+
+    void AMRVolume::advance(simd::vmaski active, RayN &ray) const
+    {
+      const float step = samplingStep / samplingRate;
+
+      ray.t0 = simd::select(active, ray.t0 + step, ray.t0);
+    }
+
+    simd::vmaski
+    AMRVolume::advanceAdaptive(simd::vmaski active,
+                               RayN &ray,
+                               simd::vfloat &lastStep,
+                               const simd::vfloat &sampleOpacity) const
+    {
+      simd::vfloat width {samplingStep};
+
+      simd::foreach_active(active, [&](int i) {
+        width[i] = cellWidthAt(vec3f{ray.org.x[i] + ray.t0[i] * ray.dir.x[i],
+                                     ray.org.y[i] + ray.t0[i] * ray.dir.y[i],
+                                     ray.org.z[i] + ray.t0[i] * ray.dir.z[i]});
+      });
+
+      const float maxRate = ospcommon::max(samplingRate,
+                                           adaptiveMaxSamplingRate);
+
+      simd::vfloat rate = adaptiveScalar * sampleOpacity;
+      rate = simd::select(rate > samplingRate, rate, samplingRate);
+      rate = simd::select(rate < maxRate, rate, maxRate);
+
+      const simd::vfloat step = width / rate;
+
+      const auto backtrack = active
+                             & (sampleOpacity > adaptiveBacktrack)
+                             & (lastStep > 1.25f * step);
+      const auto accepted  = active & !backtrack;
+
+      ray.t0 = simd::select(backtrack, ray.t0 + step - lastStep,
+                            simd::select(accepted, ray.t0 + step, ray.t0));
+      lastStep = simd::select(active, step, lastStep);
+
+      return accepted;
+    }
+
+    // Helper functions ///////////////////////////////////////////////////////
+
+    void AMRVolume::gatherBricks()
+    {
+      exitOnCondition(brickInfoArray->numBytes % sizeof(BrickInfo) != 0,
+                      "AMR 'brickInfo' must hold (box3i, level, cellWidth) "
+                      "entries");
+      exitOnCondition(brickDataArray->type != OSP_DATA &&
+                      brickDataArray->type != OSP_OBJECT,
+                      "AMR 'brickData' must be an array of data arrays");
+
+      const size_t numBricks = brickInfoArray->numBytes / sizeof(BrickInfo);
+      exitOnCondition(brickDataArray->numItems != numBricks,
+                      "AMR volumes need one 'brickData' array per brick");
+
+      const auto *infos  = (const BrickInfo*)brickInfoArray->data;
+      auto      **arrays = (Data**)brickDataArray->data;
+
+      bricks.resize(numBricks);
+      brickValues.resize(numBricks);
+
+      samplingStep = inf;
+      maxCellWidth = 0.f;
+
+      for (size_t i = 0; i < numBricks; ++i) {
+        const BrickInfo &info = infos[i];
+        Brick &brick = bricks[i];
+
+        brick.dimensions   = info.box.upper - info.box.lower + 1;
+        brick.level        = info.level;
+        brick.cellWidth    = info.cellWidth;
+        brick.rcpCellWidth = 1.f / info.cellWidth;
+
+        exitOnCondition(reduce_min(brick.dimensions) <= 0 ||
+                        !(info.cellWidth > 0.f),
+                        "invalid AMR brick");
+
+        brick.bounds =
+            box3f{gridOrigin + vec3f{info.box.lower} * info.cellWidth,
+                  gridOrigin + vec3f{info.box.upper + 1} * info.cellWidth};
+
+        brickValues[i] = arrays[i];
+
+        const size_t numCells = size_t(brick.dimensions.x)
+                                * brick.dimensions.y * brick.dimensions.z;
+
+        exitOnCondition(arrays[i] == nullptr ||
+                        arrays[i]->type != OSP_FLOAT ||
+                        arrays[i]->numItems < numCells,
+                        "AMR brick data must hold a float per cell");
+
+        brick.values = (const float*)arrays[i]->data;
+
+        samplingStep = ospcommon::min(samplingStep, info.cellWidth);
+        maxCellWidth = ospcommon::max(maxCellWidth, info.cellWidth);
+      }
+
+      if (numBricks == 0) {
+        samplingStep = 1.f;
+        maxCellWidth = 1.f;
+      }
+    }
+
+    float AMRVolume::sampleBrick(const Brick &brick,
+                                 const vec3f &worldCoordinates) const
+    {
+      const vec3i &dims = brick.dimensions;
+
+      // Values sit at cell centers; there is no interpolation across bricks.
+      const vec3f localCoordinates =
+          clamp((worldCoordinates - brick.bounds.lower) * brick.rcpCellWidth
+                - 0.5f,
+                vec3f{0.f}, vec3f{dims - 1});
+
+      const vec3i vi_0 {int(localCoordinates.x),
+                        int(localCoordinates.y),
+                        int(localCoordinates.z)};
+      const vec3i vi_1 = min(vi_0 + 1, dims - 1);
+
+      const vec3f flc = localCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      auto value = [&](int x, int y, int z) {
+        return brick.values[x + dims.x * (y + size_t(dims.y) * z)];
+      };
+
+      const float vv_000 = value(vi_0.x, vi_0.y, vi_0.z);
+      const float vv_001 = value(vi_1.x, vi_0.y, vi_0.z);
+      const float vv_010 = value(vi_0.x, vi_1.y, vi_0.z);
+      const float vv_011 = value(vi_1.x, vi_1.y, vi_0.z);
+      const float vv_100 = value(vi_0.x, vi_0.y, vi_1.z);
+      const float vv_101 = value(vi_1.x, vi_0.y, vi_1.z);
+      const float vv_110 = value(vi_0.x, vi_1.y, vi_1.z);
+      const float vv_111 = value(vi_1.x, vi_1.y, vi_1.z);
+
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    float AMRVolume::cellWidthAt(const vec3f &worldCoordinates) const
+    {
+      const int brickID = accelerator.locate(worldCoordinates);
+      return brickID < 0 ? maxCellWidth : bricks[brickID].cellWidth;
+    }
+
+    OSP_REGISTER_VOLUME(AMRVolume, cpp_amr_volume);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
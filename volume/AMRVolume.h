@@ -0,0 +1,147 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "common/Data.h"
+#include "Volume.h"
+#include "AMRAccelerator.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Block-structured AMR volume: a set of bricks of cell centered values,
+        each on the grid of its refinement level ("brickInfo"), with their
+        values in application arrays which are sampled in place
+        ("brickData"). A point is sampled in the finest brick containing it,
+        found through a k-d tree over the bricks, and adaptive sampling steps
+        at the cell width of the level found at each position. */
+    class AMRVolume : public Volume
+    {
+    public:
+
+      //! Layout of the entries of the "brickInfo" array.
+      struct BrickInfo
+      {
+        //! Inclusive range of the brick's cells on its level's grid.
+        box3i box;
+        int   level;
+        float cellWidth;
+      };
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      //! AMR volumes take their values from "brickData" (this fails).
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      void computeSamples(float **results,
+                          const vec3f *worldCoordinates,
+                          const size_t &count) override;
+
+      // cpp_renderer::Volume interface //
+
+      //! Value of the finest brick at the given point, NaN outside of all
+      //! bricks.
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      vec3f computeGradient(const vec3f &worldCoordinates) const override;
+
+      bool intersect(Ray &ray) const override;
+
+      //! Steps at the finest level's cell width (see advanceAdaptive()).
+      void advance(Ray &ray, float stepScale) const override;
+
+      //! Steps at the cell width of the finest brick at 'ray.t0'.
+      bool advanceAdaptive(Ray &ray,
+                           float &lastStep,
+                           float sampleOpacity,
+                           float stepScale) const override;
+
+      void intersectIsosurface(const std::vector<float> &isovalues,
+                               Ray &ray) const override;
+
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+
+      simd::vmaski intersect(simd::vmaski active, RayN &ray) const override;
+
+      void advance(simd::vmaski active, RayN &ray) const override;
+
+      simd::vmaski advanceAdaptive(simd::vmaski active,
+                                   RayN &ray,
+                                   simd::vfloat &lastStep,
+                                   const simd::vfloat &sampleOpacity)
+                                   const override;
+
+    private:
+
+      struct Brick
+      {
+        //! World space bounds of the brick's cells.
+        box3f bounds;
+        vec3i dimensions;
+        int   level;
+        float cellWidth;
+        float rcpCellWidth;
+
+        //! x-fastest values, one per cell.
+        const float *values;
+      };
+
+      // Helper functions //
+
+      //! Resolve the bricks from "brickInfo" and "brickData".
+      void gatherBricks();
+
+      //! Trilinearly interpolate the cell centered values of a brick,
+      //! clamped to its outermost cell centers.
+      float sampleBrick(const Brick &brick, const vec3f &worldCoordinates) const;
+
+      //! Cell width of the finest brick at the point (that of the coarsest
+      //! level outside of all bricks).
+      float cellWidthAt(const vec3f &worldCoordinates) const;
+
+      // Data //
+
+      //! Arrays the bricks were last resolved from.
+      Ref<Data> brickInfoArray;
+      Ref<Data> brickDataArray;
+
+      //! World space position of the grid's (0, 0, 0) corner the bricks were
+      //! last placed at.
+      vec3f gridOrigin {0.f};
+
+      std::vector<Brick> bricks;
+
+      //! The application's value array of each brick.
+      std::vector<Ref<Data>> brickValues;
+
+      AMRAccelerator accelerator;
+
+      //! Cell width of the coarsest level.
+      float maxCellWidth {1.f};
+    };
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
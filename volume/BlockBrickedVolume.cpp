@@ -17,6 +17,10 @@
 //ospray
 #include "BlockBrickedVolume.h"
 #include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 
 //! The number of bits used to represent the width of a Block in voxels.
 #define BLOCK_VOXEL_WIDTH_BITCOUNT (6)
@@ -42,6 +46,9 @@
 //! The bits denoting the offset of a voxel within a brick.
 #define BRICK_VOXEL_BITMASK (BRICK_VOXEL_WIDTH - 1)
 
+//! The bits denoting the offset of a voxel within a block.
+#define BLOCK_VOXEL_BITMASK (BLOCK_VOXEL_WIDTH - 1)
+
 //! The number of voxels contained in a block.
 #define BLOCK_VOXEL_COUNT (BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH)
 
@@ -50,6 +57,40 @@ namespace ospray {
 
     using BBV = BlockBrickedVolume;
 
+    // Helper functions ///////////////////////////////////////////////////////
+
+    /*! The offset of a voxel from the start of the block memory is the sum of
+        independent terms for each axis (block, brick and voxel bits of the
+        address never overlap), so neighbors are reached by adding per-axis
+        deltas to a single base offset. */
+    static inline uint64 axisOffset(int coord, uint64 blockStride, int axis)
+    {
+      const int brickShift =
+          3 * BRICK_VOXEL_WIDTH_BITCOUNT + axis * BLOCK_BRICK_WIDTH_BITCOUNT;
+      const int voxelShift = axis * BRICK_VOXEL_WIDTH_BITCOUNT;
+
+      return uint64(coord >> BLOCK_VOXEL_WIDTH_BITCOUNT) * blockStride
+        + (uint64((coord >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << brickShift)
+        + (uint64(coord & BRICK_VOXEL_BITMASK) << voxelShift);
+    }
+
+    //! axisOffset() for a packet of coordinates, for volumes whose voxel
+    //! offsets fit in 32 bits.
+    static inline simd::vint axisOffsets(const simd::vint &coord,
+                                         uint64 blockStride,
+                                         int axis)
+    {
+      const int brickShift =
+          3 * BRICK_VOXEL_WIDTH_BITCOUNT + axis * BLOCK_BRICK_WIDTH_BITCOUNT;
+      const int voxelShift = axis * BRICK_VOXEL_WIDTH_BITCOUNT;
+
+      return (coord >> BLOCK_VOXEL_WIDTH_BITCOUNT) * int(blockStride)
+        + (((coord >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << brickShift)
+        + ((coord & BRICK_VOXEL_BITMASK) << voxelShift);
+    }
+
     // BlockBrickedVolume definitions /////////////////////////////////////////
 
     BlockBrickedVolume::~BlockBrickedVolume()
@@ -64,7 +105,31 @@ namespace ospray {
 
     void BBV::commit()
     {
-      if (!blockMem) constructVolumeMemory();
+      if (voxel_t == OSP_UNKNOWN) constructVolumeMemory();
+
+      if (sparse) {
+        switch (voxel_t) {
+        case OSP_UCHAR:
+          collapseUniformBlocks<uint8>();
+          break;
+        case OSP_SHORT:
+          collapseUniformBlocks<int16>();
+          break;
+        case OSP_USHORT:
+          collapseUniformBlocks<uint16>();
+          break;
+        case OSP_FLOAT:
+          collapseUniformBlocks<float>();
+          break;
+        case OSP_DOUBLE:
+          collapseUniformBlocks<double>();
+          break;
+        default:
+          break;
+        }
+      }
+
+      selectSampler();
       StructuredVolume::commit();
     }
 
@@ -85,65 +150,75 @@ namespace ospray {
 
       const bool upsampling = scaleRegion(source, finalSource,
                                           finalRegionSize, finalRegionCoords);
-      // Copy voxel data into the volume.
-      const size_t NTASKS = finalRegionSize.y * finalRegionSize.z;
 
       if (voxel_t == OSP_UNKNOWN)
         constructVolumeMemory();
 
+      loadRegion(blockMem, finalSource, finalRegionCoords, finalRegionSize);
+
+      accumulateStatistics(voxel_t, finalSource,
+                           finalRegionCoords, finalRegionSize);
+
+      // If we're upsampling finalSource points at the chunk of data allocated by
+      // scaleRegion to hold the upsampled volume data and we must free it.
+      if (upsampling) {
+        free(finalSource);
+      }
+
+      return true;
+    }
+
+    void BBV::loadRegion(byte_t *memory,
+                         const void *source,
+                         const vec3i &regionCoords,
+                         const vec3i &regionSize)
+    {
+      // Copy voxel data into the volume, one task per block overlapped by the
+      // part of the region which lies inside of the volume.
+      const box3i target {max(regionCoords, vec3i(0)),
+                          min(regionCoords + regionSize, dimensions)};
+
+      const vec3i blockRange = reduce_min(target.upper - target.lower) > 0 ?
+          (target.upper - 1) / BLOCK_VOXEL_WIDTH
+            - target.lower / BLOCK_VOXEL_WIDTH + 1 : vec3i(0);
+
+      const size_t NTASKS = size_t(blockRange.x) * blockRange.y * blockRange.z;
+
       switch (voxel_t) {
       case OSP_UCHAR:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<uint8, BLOCK_VOXEL_COUNT>(finalSource,
-                                                   finalRegionCoords,
-                                                   finalRegionSize,
-                                                   taskIndex);
+          setBlockValues<uint8>(memory, source, regionCoords,
+                                regionSize, target, taskIndex);
         });
         break;
       case OSP_SHORT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<int16, BLOCK_VOXEL_COUNT>(finalSource,
-                                                   finalRegionCoords,
-                                                   finalRegionSize,
-                                                   taskIndex);
+          setBlockValues<int16>(memory, source, regionCoords,
+                                regionSize, target, taskIndex);
         });
         break;
       case OSP_USHORT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<uint16, BLOCK_VOXEL_COUNT>(finalSource,
-                                                    finalRegionCoords,
-                                                    finalRegionSize,
-                                                    taskIndex);
+          setBlockValues<uint16>(memory, source, regionCoords,
+                                 regionSize, target, taskIndex);
         });
         break;
       case OSP_FLOAT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<float, BLOCK_VOXEL_COUNT>(finalSource,
-                                                   finalRegionCoords,
-                                                   finalRegionSize,
-                                                   taskIndex);
+          setBlockValues<float>(memory, source, regionCoords,
+                                regionSize, target, taskIndex);
         });
         break;
       case OSP_DOUBLE:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<double, BLOCK_VOXEL_COUNT>(finalSource,
-                                                    finalRegionCoords,
-                                                    finalRegionSize,
-                                                    taskIndex);
+          setBlockValues<double>(memory, source, regionCoords,
+                                 regionSize, target, taskIndex);
         });
         break;
       default:
         throw std::runtime_error("No voxel_t specificed in cpp bbv!");
         break;
       }
-
-      // If we're upsampling finalSource points at the chunk of data allocated by
-      // scaleRegion to hold the upsampled volume data and we must free it.
-      if (upsampling) {
-        free(finalSource);
-      }
-
-      return true;
     }
 
     float BBV::getVoxel(const vec3i &index) const
@@ -175,6 +250,526 @@ namespace ospray {
       return inf;
     }
 
+    simd::vfloat BBV::getVoxel(simd::vmaski active,
+                               const simd::vec3i &index) const
+    {
+      // Same addressing as getVoxelAddress(), computed for all lanes at once.
+      const simd::vint block =
+          (index.x >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+          + blockCount.x * ((index.y >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+                            + blockCount.y
+                              * (index.z >> BLOCK_VOXEL_WIDTH_BITCOUNT));
+
+      const simd::vint brickAddress =
+          ((index.x >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+          | (((index.y >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+             << BLOCK_BRICK_WIDTH_BITCOUNT)
+          | (((index.z >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+             << (2 * BLOCK_BRICK_WIDTH_BITCOUNT));
+
+      const simd::vint voxel =
+          (brickAddress << (3 * BRICK_VOXEL_WIDTH_BITCOUNT))
+          | ((index.z & BRICK_VOXEL_BITMASK) << (2 * BRICK_VOXEL_WIDTH_BITCOUNT))
+          | ((index.y & BRICK_VOXEL_BITMASK) << BRICK_VOXEL_WIDTH_BITCOUNT)
+          | (index.x & BRICK_VOXEL_BITMASK);
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        return getVoxelValues<uint8, BLOCK_VOXEL_COUNT>(active, block, voxel);
+        break;
+      case OSP_SHORT:
+        return getVoxelValues<int16, BLOCK_VOXEL_COUNT>(active, block, voxel);
+        break;
+      case OSP_USHORT:
+        return getVoxelValues<uint16, BLOCK_VOXEL_COUNT>(active, block, voxel);
+        break;
+      case OSP_FLOAT:
+        return getVoxelValues<float, BLOCK_VOXEL_COUNT>(active, block, voxel);
+        break;
+      case OSP_DOUBLE:
+        return getVoxelValues<double, BLOCK_VOXEL_COUNT>(active, block, voxel);
+        break;
+      default:
+        break;
+      }
+
+      return simd::vfloat{inf};
+    }
+
+    float BBV::computeSample(const vec3f &worldCoordinates) const
+    {
+      return (this->*sampleFcn)(worldCoordinates);
+    }
+
+    simd::vfloat BBV::computeSample(simd::vmaski active,
+                                    const simd::vec3f &worldCoordinates) const
+    {
+      return (this->*sampleFcnN)(active, worldCoordinates);
+    }
+
+    void BBV::selectSampler()
+    {
+      if (sparse) {
+        switch (voxel_t) {
+        case OSP_UCHAR:
+          sampleFcn  = &BBV::computeSampleSparse_T<uint8>;
+          sampleFcnN = &BBV::computeSampleSparse_T<uint8>;
+          break;
+        case OSP_SHORT:
+          sampleFcn  = &BBV::computeSampleSparse_T<int16>;
+          sampleFcnN = &BBV::computeSampleSparse_T<int16>;
+          break;
+        case OSP_USHORT:
+          sampleFcn  = &BBV::computeSampleSparse_T<uint16>;
+          sampleFcnN = &BBV::computeSampleSparse_T<uint16>;
+          break;
+        case OSP_FLOAT:
+          sampleFcn  = &BBV::computeSampleSparse_T<float>;
+          sampleFcnN = &BBV::computeSampleSparse_T<float>;
+          break;
+        case OSP_DOUBLE:
+          sampleFcn  = &BBV::computeSampleSparse_T<double>;
+          sampleFcnN = &BBV::computeSampleSparse_T<double>;
+          break;
+        default:
+          throw std::runtime_error("No voxel_t specificed in cpp bbv!");
+          break;
+        }
+        return;
+      }
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        sampleFcn  = &BBV::computeSample_T<uint8>;
+        sampleFcnN = &BBV::computeSample_T<uint8>;
+        break;
+      case OSP_SHORT:
+        sampleFcn  = &BBV::computeSample_T<int16>;
+        sampleFcnN = &BBV::computeSample_T<int16>;
+        break;
+      case OSP_USHORT:
+        sampleFcn  = &BBV::computeSample_T<uint16>;
+        sampleFcnN = &BBV::computeSample_T<uint16>;
+        break;
+      case OSP_FLOAT:
+        sampleFcn  = &BBV::computeSample_T<float>;
+        sampleFcnN = &BBV::computeSample_T<float>;
+        break;
+      case OSP_DOUBLE:
+        sampleFcn  = &BBV::computeSample_T<double>;
+        sampleFcnN = &BBV::computeSample_T<double>;
+        break;
+      default:
+        throw std::runtime_error("No voxel_t specificed in cpp bbv!");
+        break;
+      }
+    }
+
+    template <typename T>
+    float BBV::computeSample_T(const vec3f &worldCoordinates) const
+    {
+      vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3f clampedLocalCoordinates = clamp(localCoordinates,
+                                                  vec3f{0.0f},
+                                                  localCoordinatesUpperBound);
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {clampedLocalCoordinates.x,
+                        clampedLocalCoordinates.y,
+                        clampedLocalCoordinates.z};
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = clampedLocalCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      // Offset of the lower corner voxel and the deltas to its neighbors,
+      // which may lie across a brick or block boundary.
+      const uint64 ofs_x = axisOffset(vi_0.x, blockStride[0], 0);
+      const uint64 ofs_y = axisOffset(vi_0.y, blockStride[1], 1);
+      const uint64 ofs_z = axisOffset(vi_0.z, blockStride[2], 2);
+
+      const uint64 dx = axisOffset(vi_0.x + 1, blockStride[0], 0) - ofs_x;
+      const uint64 dy = axisOffset(vi_0.y + 1, blockStride[1], 1) - ofs_y;
+      const uint64 dz = axisOffset(vi_0.z + 1, blockStride[2], 2) - ofs_z;
+
+      const T *voxels = (const T*)blockMem + (ofs_x + ofs_y + ofs_z);
+
+      // "vv" means "voxelValue"
+      const float vv_000 = float(voxels[0]);
+      const float vv_001 = float(voxels[dx]);
+      const float vv_010 = float(voxels[dy]);
+      const float vv_011 = float(voxels[dx + dy]);
+      const float vv_100 = float(voxels[dz]);
+      const float vv_101 = float(voxels[dx + dz]);
+      const float vv_110 = float(voxels[dy + dz]);
+      const float vv_111 = float(voxels[dx + dy + dz]);
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    simd::vfloat BBV::computeSample_T(simd::vmaski active,
+                                      const simd::vec3f &worldCoordinates) const
+    {
+      const simd::vec3f clampedLocalCoordinates =
+          clampLocal(transformWorldToLocal(worldCoordinates));
+
+      // "vi" means "voxelIndex"
+      const simd::vec3i vi_0 {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z)
+      };
+
+      // "flc" means "fractionalLocalCoordinates"
+      const simd::vec3f flc {
+        clampedLocalCoordinates.x - simd::cast<simd::vfloat>(vi_0.x),
+        clampedLocalCoordinates.y - simd::cast<simd::vfloat>(vi_0.y),
+        clampedLocalCoordinates.z - simd::cast<simd::vfloat>(vi_0.z)
+      };
+
+      // "vv" means "voxelValue"
+      simd::vfloat vv_000 {0.f}, vv_001 {0.f}, vv_010 {0.f}, vv_011 {0.f};
+      simd::vfloat vv_100 {0.f}, vv_101 {0.f}, vv_110 {0.f}, vv_111 {0.f};
+
+      // Float voxels of volumes addressable with 32-bit offsets are gathered
+      // for all active lanes at once.
+      if (std::is_same<T, float>::value && gatherVoxels) {
+        const simd::vint ofs_x = axisOffsets(vi_0.x, blockStride[0], 0);
+        const simd::vint ofs_y = axisOffsets(vi_0.y, blockStride[1], 1);
+        const simd::vint ofs_z = axisOffsets(vi_0.z, blockStride[2], 2);
+
+        const auto dx = axisOffsets(vi_0.x + 1, blockStride[0], 0) - ofs_x;
+        const auto dy = axisOffsets(vi_0.y + 1, blockStride[1], 1) - ofs_y;
+        const auto dz = axisOffsets(vi_0.z + 1, blockStride[2], 2) - ofs_z;
+
+        const simd::vint ofs = ofs_x + ofs_y + ofs_z;
+        const float *voxels  = (const float*)blockMem;
+
+        simd::gather(vv_000, voxels, ofs, active);
+        simd::gather(vv_001, voxels, ofs + dx, active);
+        simd::gather(vv_010, voxels, ofs + dy, active);
+        simd::gather(vv_011, voxels, ofs + dx + dy, active);
+        simd::gather(vv_100, voxels, ofs + dz, active);
+        simd::gather(vv_101, voxels, ofs + dx + dz, active);
+        simd::gather(vv_110, voxels, ofs + dy + dz, active);
+        simd::gather(vv_111, voxels, ofs + dx + dy + dz, active);
+      } else {
+        // Other voxel types (converted to float on load) and volumes needing
+        // 64-bit offsets are loaded per lane.
+        simd::foreach_active(active, [&](int i) {
+          const uint64 ofs_x = axisOffset(vi_0.x[i], blockStride[0], 0);
+          const uint64 ofs_y = axisOffset(vi_0.y[i], blockStride[1], 1);
+          const uint64 ofs_z = axisOffset(vi_0.z[i], blockStride[2], 2);
+
+          const uint64 dx =
+              axisOffset(vi_0.x[i] + 1, blockStride[0], 0) - ofs_x;
+          const uint64 dy =
+              axisOffset(vi_0.y[i] + 1, blockStride[1], 1) - ofs_y;
+          const uint64 dz =
+              axisOffset(vi_0.z[i] + 1, blockStride[2], 2) - ofs_z;
+
+          const T *voxels = (const T*)blockMem + (ofs_x + ofs_y + ofs_z);
+
+          vv_000[i] = float(voxels[0]);
+          vv_001[i] = float(voxels[dx]);
+          vv_010[i] = float(voxels[dy]);
+          vv_011[i] = float(voxels[dx + dy]);
+          vv_100[i] = float(voxels[dz]);
+          vv_101[i] = float(voxels[dx + dz]);
+          vv_110[i] = float(voxels[dy + dz]);
+          vv_111[i] = float(voxels[dx + dy + dz]);
+        });
+      }
+
+      // Interpolate the voxel values.
+      const auto vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const auto vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const auto vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const auto vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const auto vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const auto vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    float BBV::computeSampleSparse_T(const vec3f &worldCoordinates) const
+    {
+      vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3f clampedLocalCoordinates = clamp(localCoordinates,
+                                                  vec3f{0.0f},
+                                                  localCoordinatesUpperBound);
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {clampedLocalCoordinates.x,
+                        clampedLocalCoordinates.y,
+                        clampedLocalCoordinates.z};
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = clampedLocalCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      // "vv" means "voxelValue"
+      float vv[8];
+      getSparseCellValues<T>(vi_0, vv);
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv[0] + flc.x * (vv[1] - vv[0]);
+      const float vv_01 = vv[2] + flc.x * (vv[3] - vv[2]);
+      const float vv_10 = vv[4] + flc.x * (vv[5] - vv[4]);
+      const float vv_11 = vv[6] + flc.x * (vv[7] - vv[6]);
+      const float vv_0  = vv_00 + flc.y * (vv_01 - vv_00);
+      const float vv_1  = vv_10 + flc.y * (vv_11 - vv_10);
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    simd::vfloat
+    BBV::computeSampleSparse_T(simd::vmaski active,
+                               const simd::vec3f &worldCoordinates) const
+    {
+      const simd::vec3f clampedLocalCoordinates =
+          clampLocal(transformWorldToLocal(worldCoordinates));
+
+      // "vi" means "voxelIndex"
+      const simd::vec3i vi_0 {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z)
+      };
+
+      // "flc" means "fractionalLocalCoordinates"
+      const simd::vec3f flc {
+        clampedLocalCoordinates.x - simd::cast<simd::vfloat>(vi_0.x),
+        clampedLocalCoordinates.y - simd::cast<simd::vfloat>(vi_0.y),
+        clampedLocalCoordinates.z - simd::cast<simd::vfloat>(vi_0.z)
+      };
+
+      // "vv" means "voxelValue"
+      simd::vfloat vv[8];
+      for (auto &v : vv)
+        v = simd::vfloat{0.f};
+
+      simd::foreach_active(active, [&](int i) {
+        float values[8];
+        getSparseCellValues<T>(vec3i{vi_0.x[i], vi_0.y[i], vi_0.z[i]}, values);
+        for (int c = 0; c < 8; ++c)
+          vv[c][i] = values[c];
+      });
+
+      // Interpolate the voxel values.
+      const auto vv_00 = vv[0] + flc.x * (vv[1] - vv[0]);
+      const auto vv_01 = vv[2] + flc.x * (vv[3] - vv[2]);
+      const auto vv_10 = vv[4] + flc.x * (vv[5] - vv[4]);
+      const auto vv_11 = vv[6] + flc.x * (vv[7] - vv[6]);
+      const auto vv_0  = vv_00 + flc.y * (vv_01 - vv_00);
+      const auto vv_1  = vv_10 + flc.y * (vv_11 - vv_10);
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    void BBV::getSparseCellValues(const vec3i &index, float values[8]) const
+    {
+      // As for the dense layout the address is a sum of per-axis terms, here
+      // kept apart for the block (looked up in the table) and the voxel.
+      auto blockTerm = [&](int coord, int axis) {
+        const uint32 stride = axis == 0 ? 1 :
+                              axis == 1 ? blockCount.x :
+                                          blockCount.x * blockCount.y;
+        return (coord >> BLOCK_VOXEL_WIDTH_BITCOUNT) * stride;
+      };
+
+      auto voxelTerm = [&](int coord, int axis) {
+        return uint32(axisOffset(coord & (BLOCK_VOXEL_WIDTH - 1), 0, axis));
+      };
+
+      const uint32 block[3][2] = {
+        {blockTerm(index.x, 0), blockTerm(index.x + 1, 0)},
+        {blockTerm(index.y, 1), blockTerm(index.y + 1, 1)},
+        {blockTerm(index.z, 2), blockTerm(index.z + 1, 2)}
+      };
+
+      const uint32 voxel[3][2] = {
+        {voxelTerm(index.x, 0), voxelTerm(index.x + 1, 0)},
+        {voxelTerm(index.y, 1), voxelTerm(index.y + 1, 1)},
+        {voxelTerm(index.z, 2), voxelTerm(index.z + 1, 2)}
+      };
+
+      for (int c = 0; c < 8; ++c) {
+        const int dx = c & 1, dy = (c >> 1) & 1, dz = c >> 2;
+
+        const uint32 b = block[0][dx] + block[1][dy] + block[2][dz];
+        const uint32 v = voxel[0][dx] + voxel[1][dy] + voxel[2][dz];
+
+        const T *blockPtr = (const T*)blockTable[b].load(
+            std::memory_order_acquire);
+        values[c] = blockPtr ? float(blockPtr[v]) : uniformValue[b];
+      }
+    }
+
+    const byte_t *BBV::getBlockMemory(uint32 block) const
+    {
+      return sparse ? blockTable[block].load(std::memory_order_acquire)
+                    : blockMem + uint64(block) * BLOCK_VOXEL_COUNT * voxelSize;
+    }
+
+    template <typename T>
+    T *BBV::getWritableBlock(uint32 block, T value)
+    {
+      byte_t *memory = blockTable[block].load(std::memory_order_acquire);
+
+      if (memory)
+        return (T*)memory;
+
+      std::lock_guard<std::mutex> lock(allocationMutex);
+
+      memory = blockTable[block].load(std::memory_order_acquire);
+
+      if (!memory) {
+        const T fill = T(uniformValue[block]);
+
+        if (value == fill)
+          return nullptr;
+
+        memory = new byte_t[BLOCK_VOXEL_COUNT * sizeof(T)];
+        std::fill((T*)memory, (T*)memory + BLOCK_VOXEL_COUNT, fill);
+
+        blockTable[block].store(memory, std::memory_order_release);
+      }
+
+      return (T*)memory;
+    }
+
+    template <typename T>
+    void BBV::setBlockValues(byte_t *memory,
+                             const void *_source,
+                             const vec3i &regionCoords,
+                             const vec3i &regionSize,
+                             const box3i &target,
+                             size_t taskIndex)
+    {
+      const vec3i firstBlock = target.lower / BLOCK_VOXEL_WIDTH;
+      const vec3i blockRange = (target.upper - 1) / BLOCK_VOXEL_WIDTH
+                               - firstBlock + 1;
+
+      const vec3i blockIndex = firstBlock
+        + vec3i(taskIndex % blockRange.x,
+                (taskIndex / blockRange.x) % blockRange.y,
+                taskIndex / (size_t(blockRange.x) * blockRange.y));
+
+      const uint32 block = blockIndex.x
+        + blockCount.x * (blockIndex.y + blockCount.y * blockIndex.z);
+
+      // The voxels of the target region inside of this block.
+      const vec3i blockLower = blockIndex * BLOCK_VOXEL_WIDTH;
+      const vec3i lower = max(target.lower, blockLower);
+      const vec3i upper = min(target.upper, blockLower + BLOCK_VOXEL_WIDTH);
+
+      // Sparse mode: the block stays uniform until a differing value arrives.
+      T *blockPtr = sparse ?
+          (T*)blockTable[block].load(std::memory_order_acquire) :
+          (T*)memory + uint64(block) * BLOCK_VOXEL_COUNT;
+      const T fill = sparse ? T(uniformValue[block]) : T(0);
+
+      const T *source = (const T*)_source;
+      const uint64 sliceSize = uint64(regionSize.x) * regionSize.y;
+
+      // Visit the bricks in memory order so the block is written front to
+      // back; a brick row is contiguous both in the source and in the block.
+      const vec3i firstBrick {lower.x & ~BRICK_VOXEL_BITMASK,
+                              lower.y & ~BRICK_VOXEL_BITMASK,
+                              lower.z & ~BRICK_VOXEL_BITMASK};
+
+      for (int bz = firstBrick.z; bz < upper.z; bz += BRICK_VOXEL_WIDTH) {
+        for (int by = firstBrick.y; by < upper.y; by += BRICK_VOXEL_WIDTH) {
+          for (int bx = firstBrick.x; bx < upper.x; bx += BRICK_VOXEL_WIDTH) {
+            const int x0 = std::max(bx, lower.x);
+            const int x1 = std::min(bx + BRICK_VOXEL_WIDTH, upper.x);
+            const uint64 xOfs = axisOffset(x0 & BLOCK_VOXEL_BITMASK, 0, 0);
+
+            const int z1 = std::min(bz + BRICK_VOXEL_WIDTH, upper.z);
+            const int y1 = std::min(by + BRICK_VOXEL_WIDTH, upper.y);
+
+            for (int z = std::max(bz, lower.z); z < z1; ++z) {
+              const uint64 zOfs = axisOffset(z & BLOCK_VOXEL_BITMASK, 0, 2);
+
+              for (int y = std::max(by, lower.y); y < y1; ++y) {
+                const T *run = source + (x0 - regionCoords.x)
+                  + uint64(y - regionCoords.y) * regionSize.x
+                  + uint64(z - regionCoords.z) * sliceSize;
+
+                if (!blockPtr) {
+                  const T *value = std::find_if(run, run + (x1 - x0),
+                                                [&](T v) { return v != fill; });
+                  if (value == run + (x1 - x0))
+                    continue;
+
+                  blockPtr = getWritableBlock<T>(block, *value);
+                }
+
+                const uint64 yOfs = axisOffset(y & BLOCK_VOXEL_BITMASK, 0, 1);
+                std::copy(run, run + (x1 - x0), blockPtr + xOfs + yOfs + zOfs);
+              }
+            }
+          }
+        }
+      }
+
+      // Only blocks written since the last commit may have become uniform
+      // (each block is written by a single task).
+      if (sparse && blockPtr)
+        dirtyBlocks[block] = 1;
+    }
+
+    template <typename T>
+    void BBV::collapseUniformBlocks()
+    {
+      std::vector<uint32> written;
+
+      for (size_t block = 0; block < dirtyBlocks.size(); ++block) {
+        if (dirtyBlocks[block]) {
+          written.push_back(block);
+          dirtyBlocks[block] = 0;
+        }
+      }
+
+      tasking::parallel_for(written.size(), [&](size_t i) {
+        const uint32 block = written[i];
+        const T *voxels = (const T*)blockTable[block].load();
+
+        if (!voxels)
+          return;
+
+        const T first = voxels[0];
+        if (std::all_of(voxels, voxels + BLOCK_VOXEL_COUNT,
+                        [&](T v) { return v == first; })) {
+          uniformValue[block] = float(first);
+          blockTable[block].store(nullptr);
+          delete [] (const byte_t*)voxels;
+        }
+      });
+    }
+
+    size_t BBV::brickID(const vec3f &worldCoordinates) const
+    {
+      const Address address = getVoxelAddress(voxelIndex(worldCoordinates));
+
+      // The voxel address holds the brick address above the voxel offset.
+      return (size_t(address.block) << (3 * BLOCK_BRICK_WIDTH_BITCOUNT))
+             | (address.voxel >> (3 * BRICK_VOXEL_WIDTH_BITCOUNT));
+    }
+
     BBV::Address BBV::getVoxelAddress(const vec3i &index) const
     {
       Address address;
@@ -239,14 +834,38 @@ namespace ospray {
       // Volume size in blocks with padding.
       const size_t numBlocks = blockCount.x * blockCount.y * blockCount.z;
 
+      // Sparse mode starts out with every block uniformly zero.
+      sparse = getParam1i("sparse", 0);
+
+      if (sparse) {
+        blockTable = std::vector<std::atomic<byte_t*>>(numBlocks);
+        for (auto &memory : blockTable)
+          memory.store(nullptr);
+
+        uniformValue.assign(numBlocks, 0.f);
+        dirtyBlocks.assign(numBlocks, 0);
+      }
+
+      blockStride[0] = BLOCK_VOXEL_COUNT;
+      blockStride[1] = blockStride[0] * blockCount.x;
+      blockStride[2] = blockStride[1] * blockCount.y;
+
+      gatherVoxels = !sparse && blockStride[2] * blockCount.z
+                                <= uint64(std::numeric_limits<int>::max());
+
       // allocate the large array of blocks
       size_t blockSize = BLOCK_VOXEL_COUNT * voxelSize;
-      blockMem = new byte_t[blockSize * numBlocks];
+      if (!sparse)
+        blockMem = new byte_t[blockSize * numBlocks];
     }
 
     void BlockBrickedVolume::freeVolumeMemory()
     {
       if (blockMem) delete [] blockMem;
+      blockMem = nullptr;
+
+      for (auto &memory : blockTable)
+        delete [] memory.exchange(nullptr);
     }
 
 #if 0//def EXP_NEW_BB_VOLUME_KERNELS
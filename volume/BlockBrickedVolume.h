@@ -17,6 +17,10 @@
 #pragma once
 
 #include "StructuredVolume.h"
+// std
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 
 namespace ospray {
   namespace cpp_renderer {
@@ -35,7 +39,17 @@ namespace ospray {
                     const vec3i &index,
                     const vec3i &count) override;
 
-    private:
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+
+      //! The block and the brick within it holding the voxel at
+      //! 'worldCoordinates', in the order they are laid out in memory.
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+    protected:
 
       // Helper types //
 
@@ -52,15 +66,68 @@ namespace ospray {
 
       float getVoxel(const vec3i &index) const override;
 
+      simd::vfloat getVoxel(simd::vmaski active,
+                            const simd::vec3i &index) const override;
+
       // Helper functions //
 
+      //! Select the samplers specialized on the voxel type.
+      void selectSampler();
+
+      template <typename T>
+      float computeSample_T(const vec3f &worldCoordinates) const;
+
+      template <typename T>
+      simd::vfloat computeSample_T(simd::vmaski active,
+                                   const simd::vec3f &worldCoordinates) const;
+
+      template <typename T>
+      float computeSampleSparse_T(const vec3f &worldCoordinates) const;
+
+      template <typename T>
+      simd::vfloat
+      computeSampleSparse_T(simd::vmaski active,
+                            const simd::vec3f &worldCoordinates) const;
+
+      //! Fetch the 8 voxels of the cell at 'index' through the block table.
+      template <typename T>
+      void getSparseCellValues(const vec3i &index, float values[8]) const;
+
+      //! Memory of a block, or nullptr if the block is uniform.
+      const byte_t *getBlockMemory(uint32 block) const;
+
+      //! Memory of a block about to receive 'value', allocating it unless the
+      //! block is uniform with that value (returns nullptr in that case).
+      template <typename T>
+      T *getWritableBlock(uint32 block, T value);
+
+      //! Release the blocks written since the last commit whose voxels all
+      //! hold the same value.
+      template <typename T>
+      void collapseUniformBlocks();
+
       template <typename T, size_t BLOCK_VOXEL_COUNT>
       float getVoxelValue(const Address &address) const;
 
       template <typename T, size_t BLOCK_VOXEL_COUNT>
-      void setVoxelValues(void *_source,
-                          const vec3i &targetCoord000,
+      simd::vfloat getVoxelValues(simd::vmaski active,
+                                  const simd::vint &block,
+                                  const simd::vint &voxel) const;
+
+      //! Copy the voxels of a region into 'memory' (laid out like 'blockMem'),
+      //! or into 'blockTable' in sparse mode.
+      void loadRegion(byte_t *memory,
+                      const void *source,
+                      const vec3i &regionCoords,
+                      const vec3i &regionSize);
+
+      //! Copy the part of a region overlapping one block, brick by brick.
+      template <typename T>
+      void setBlockValues(byte_t *memory,
+                          const void *source,
+                          const vec3i &regionCoords,
                           const vec3i &regionSize,
+                          const box3i &target,
                           size_t taskIndex);
 
       Address getVoxelAddress(const vec3i &index) const;
@@ -82,6 +149,35 @@ namespace ospray {
       //! Voxel size in bytes.
       size_t voxelSize;
 
+      //! Allocate only non-uniform blocks, through 'blockTable'.
+      bool sparse {false};
+
+      //! Sparse mode: memory of each block, nullptr for uniform blocks.
+      std::vector<std::atomic<byte_t*>> blockTable;
+
+      //! Sparse mode: value of each uniform block.
+      std::vector<float> uniformValue;
+
+      //! Sparse mode: blocks written since the last commit, the only ones
+      //! collapseUniformBlocks() checks.
+      std::vector<uint8> dirtyBlocks;
+
+      std::mutex allocationMutex;
+
+      //! Distance (in voxels) between neighboring blocks along each axis.
+      uint64 blockStride[3] {0, 0, 0};
+
+      //! Voxel offsets fit in 32 bits, so packets gather their voxels.
+      bool gatherVoxels {false};
+
+      using SampleFcn  = float (BlockBrickedVolume::*)(const vec3f &) const;
+      using SampleFcnN = simd::vfloat (BlockBrickedVolume::*)(
+          simd::vmaski, const simd::vec3f &) const;
+
+      //! Samplers for 'voxel_t', resolved once in commit().
+      SampleFcn  sampleFcn  {nullptr};
+      SampleFcnN sampleFcnN {nullptr};
+
     };
 
     // Inlined definitions ////////////////////////////////////////////////////
@@ -89,37 +185,33 @@ namespace ospray {
     template<typename T, size_t BLOCK_VOXEL_COUNT>
     inline float BlockBrickedVolume::getVoxelValue(const Address &address) const
     {
-      T *blockPtr = (T*)blockMem + (BLOCK_VOXEL_COUNT * address.block);
-      return float(blockPtr[address.voxel]);
+      const T *blockPtr = (const T*)getBlockMemory(address.block);
+      return blockPtr ? float(blockPtr[address.voxel])
+                      : uniformValue[address.block];
     }
 
     template<typename T, size_t BLOCK_VOXEL_COUNT>
-    inline void BlockBrickedVolume::setVoxelValues(void *_source,
-                                                   const vec3i &targetCoord000,
-                                                   const vec3i &regionSize,
-                                                   size_t taskIndex)
+    inline simd::vfloat
+    BlockBrickedVolume::getVoxelValues(simd::vmaski active,
+                                       const simd::vint &block,
+                                       const simd::vint &voxel) const
     {
-      const uint32 region_y = taskIndex % regionSize.y;
-      const uint32 region_z = taskIndex / regionSize.y;
-      const uint64 runOfs = (uint64)regionSize.x *
-                            (region_y + (uint64)regionSize.y * region_z);
-      const T *run = (const T *)_source + runOfs;
-      vec3i coord = targetCoord000 + vec3i{0, region_y, region_z};
-      for(int x = 0; x < regionSize.x; ++x) {
-        coord.x = targetCoord000.x + x;
-        if (coord.x < 0 ||
-            coord.y < 0 ||
-            coord.z < 0 ||
-            coord.x >= dimensions.x ||
-            coord.y >= dimensions.y ||
-            coord.z >= dimensions.z
-            )
-          continue;
-
-        Address address = getVoxelAddress(coord);
-        T *blockPtr = (T*)blockMem + address.block * BLOCK_VOXEL_COUNT;
-        blockPtr[address.voxel] = run[x];
+      simd::vfloat result {0.f};
+
+      if (std::is_same<T, float>::value && gatherVoxels) {
+        simd::gather(result, (const float*)blockMem,
+                     block * int(BLOCK_VOXEL_COUNT) + voxel, active);
+        return result;
       }
+
+      // Other voxel types, sparse volumes (whose uniform blocks have no
+      // memory) and volumes needing 64-bit offsets are loaded per lane.
+      simd::foreach_active(active, [&](int i) {
+        result[i] = getVoxelValue<T, BLOCK_VOXEL_COUNT>(
+            Address{uint32(block[i]), uint32(voxel[i])});
+      });
+
+      return result;
     }
 
   } // ::ospray::cpp_renderer
@@ -0,0 +1,229 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "BlockCache.h"
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    static std::atomic<size_t> nextCacheID {1};
+
+    //! Seek with 64-bit offsets, block stores are usually larger than 2GB.
+    static inline void seek(std::FILE *file, uint64 offset)
+    {
+#ifdef _WIN32
+      _fseeki64(file, offset, SEEK_SET);
+#else
+      fseeko(file, off_t(offset), SEEK_SET);
+#endif
+    }
+
+    BlockCache::BlockCache(const std::string &fileName,
+                           size_t blockSize,
+                           size_t numBlocks,
+                           size_t capacity)
+      : cacheID(nextCacheID++),
+        bytesPerBlock(blockSize),
+        numBlocks(numBlocks),
+        capacity(std::max(capacity, size_t(1)))
+    {
+      if (fileName.empty()) {
+        file = std::tmpfile();
+      } else {
+        file = std::fopen(fileName.c_str(), "r+b");
+        if (!file)
+          file = std::fopen(fileName.c_str(), "w+b");
+      }
+
+      if (!file)
+        throw std::runtime_error("could not open block store '" + fileName + "'");
+    }
+
+    BlockCache::~BlockCache()
+    {
+      flush();
+      std::fclose(file);
+    }
+
+    std::shared_ptr<const byte_t> BlockCache::get(size_t blockID)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      return acquire(blockID, lock).data;
+    }
+
+    std::shared_ptr<byte_t> BlockCache::getForWriting(size_t blockID)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      auto &entry = acquire(blockID, lock);
+      entry.dirty = true;
+      return entry.data;
+    }
+
+    void BlockCache::flush()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      for (auto &e : entries) {
+        auto &entry = e.second;
+        if (entry.dirty) {
+          writeBlock(e.first, entry.data.get());
+          entry.dirty = false;
+        }
+      }
+
+      std::lock_guard<std::mutex> fileLock(fileMutex);
+      std::fflush(file);
+    }
+
+    BlockCache::Stats BlockCache::stats() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return counters;
+    }
+
+    BlockCache::Entry &BlockCache::acquire(size_t blockID,
+                                           std::unique_lock<std::mutex> &lock)
+    {
+      if (blockID >= numBlocks)
+        throw std::runtime_error("block index out of range in BlockCache");
+
+      auto found = entries.find(blockID);
+
+      // Wait for a block another thread is paging in; look it up again after
+      // every wakeup as it may have been evicted in the meantime.
+      while (found != entries.end() && found->second.loading) {
+        loaded.wait(lock);
+        found = entries.find(blockID);
+      }
+
+      if (found != entries.end()) {
+        counters.hits++;
+        auto &entry = found->second;
+        lru.splice(lru.begin(), lru, entry.lruPosition);
+        return entry;
+      }
+
+      counters.misses++;
+
+      const std::vector<Block> evicted = evictUnreferenced();
+
+      auto &entry = entries[blockID];
+
+      lru.push_front(blockID);
+      entry.lruPosition = lru.begin();
+
+      // The block's write back is still pending, its memory is current.
+      auto pending = writeBacks.find(blockID);
+
+      if (pending != writeBacks.end()) {
+        entry.data  = pending->second;
+        entry.dirty = true;
+        writeBacks.erase(pending);
+      } else {
+        entry.data = std::shared_ptr<byte_t>(new byte_t[bytesPerBlock],
+                                             std::default_delete<byte_t[]>());
+        entry.loading = true;
+      }
+
+      // Holding a reference keeps the entry from being evicted while the
+      // lock is released.
+      const std::shared_ptr<byte_t> data = entry.data;
+
+      if (entry.loading) {
+        lock.unlock();
+        readBlock(blockID, data.get());
+        lock.lock();
+
+        entry.loading = false;
+        loaded.notify_all();
+      }
+
+      if (!evicted.empty()) {
+        lock.unlock();
+
+        for (const auto &block : evicted)
+          writeBlock(block.first, block.second.get());
+
+        lock.lock();
+
+        for (const auto &block : evicted) {
+          auto written = writeBacks.find(block.first);
+          if (written != writeBacks.end() && written->second == block.second)
+            writeBacks.erase(written);
+        }
+      }
+
+      return entry;
+    }
+
+    std::vector<BlockCache::Block> BlockCache::evictUnreferenced()
+    {
+      std::vector<Block> evicted;
+
+      // Evict from the least recently used end, skipping blocks that are still
+      // referenced by a reader or writer, or are being paged in (the cache may
+      // then grow past its capacity until they are released).
+      auto position = lru.end();
+
+      while (entries.size() >= capacity && position != lru.begin()) {
+        --position;
+
+        auto &entry = entries[*position];
+
+        if (entry.data.use_count() > 1)
+          continue;
+
+        if (entry.dirty) {
+          writeBacks[*position] = entry.data;
+          evicted.emplace_back(*position, std::move(entry.data));
+        }
+
+        entries.erase(*position);
+        position = lru.erase(position);
+        counters.evictions++;
+      }
+
+      return evicted;
+    }
+
+    void BlockCache::readBlock(size_t blockID, byte_t *data)
+    {
+      std::lock_guard<std::mutex> lock(fileMutex);
+
+      seek(file, uint64(blockID) * bytesPerBlock);
+      const size_t bytesRead = std::fread(data, 1, bytesPerBlock, file);
+
+      // Blocks never written to (or past the end of the file) are zero.
+      if (bytesRead < bytesPerBlock)
+        std::memset(data + bytesRead, 0, bytesPerBlock - bytesRead);
+    }
+
+    void BlockCache::writeBlock(size_t blockID, const byte_t *data)
+    {
+      std::lock_guard<std::mutex> lock(fileMutex);
+
+      seek(file, uint64(blockID) * bytesPerBlock);
+      if (std::fwrite(data, 1, bytesPerBlock, file) != bytesPerBlock)
+        throw std::runtime_error("could not write to block store");
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,144 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+// ospray
+#include "ospray/common/OSPCommon.h"
+// std
+#include <condition_variable>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Bounded, thread-safe LRU cache of fixed size blocks which are paged in
+        from (and written back to) a backing file on demand. Blocks handed out
+        stay resident while a reference to them is held. File I/O happens
+        outside of the cache lock, so hits are not stalled by another thread
+        paging a block in or writing one back. */
+    class BlockCache
+    {
+    public:
+
+      struct Stats
+      {
+        size_t hits      {0};
+        size_t misses    {0};
+        size_t evictions {0};
+      };
+
+      /*! Open (or create) 'fileName' as the store for 'numBlocks' blocks of
+          'blockSize' bytes; an empty name uses an anonymous temporary file.
+          At most 'capacity' unreferenced blocks are kept in memory. */
+      BlockCache(const std::string &fileName,
+                 size_t blockSize,
+                 size_t numBlocks,
+                 size_t capacity);
+
+      ~BlockCache();
+
+      //! Get a block for reading.
+      std::shared_ptr<const byte_t> get(size_t blockID);
+
+      //! Get a block for writing, it is written back to the file on eviction.
+      std::shared_ptr<byte_t> getForWriting(size_t blockID);
+
+      //! Write all modified blocks back to the file.
+      void flush();
+
+      Stats stats() const;
+
+      //! Unique id of this cache, for validating per-thread block handles.
+      size_t id() const;
+
+      size_t blockSize() const;
+
+    private:
+
+      using Block = std::pair<size_t, std::shared_ptr<byte_t>>;
+
+      struct Entry
+      {
+        std::shared_ptr<byte_t> data;
+        bool dirty {false};
+
+        //! The block is being read from the file by another thread.
+        bool loading {false};
+
+        std::list<size_t>::iterator lruPosition;
+      };
+
+      //! Find or page in a block; 'lock' holds 'mutex' and is released while
+      //! the file is accessed.
+      Entry &acquire(size_t blockID, std::unique_lock<std::mutex> &lock);
+
+      //! Drop unreferenced blocks down to capacity, returning the modified
+      //! ones which still have to be written back.
+      std::vector<Block> evictUnreferenced();
+
+      void readBlock(size_t blockID, byte_t *data);
+      void writeBlock(size_t blockID, const byte_t *data);
+
+      // Data //
+
+      std::FILE *file {nullptr};
+
+      size_t cacheID;
+      size_t bytesPerBlock;
+      size_t numBlocks;
+      size_t capacity;
+
+      //! Resident blocks, with the most recently used at the front of 'lru'.
+      std::unordered_map<size_t, Entry> entries;
+      std::list<size_t> lru;
+
+      //! Evicted blocks whose write back has not finished yet, a miss on
+      //! one of them takes the block back instead of reading the file.
+      std::unordered_map<size_t, std::shared_ptr<byte_t>> writeBacks;
+
+      Stats counters;
+
+      //! Guards the entries, the LRU list and the counters.
+      mutable std::mutex mutex;
+
+      //! Signaled when a block has been paged in.
+      std::condition_variable loaded;
+
+      //! Serializes the seek + read/write pairs on 'file'.
+      std::mutex fileMutex;
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline size_t BlockCache::id() const
+    {
+      return cacheID;
+    }
+
+    inline size_t BlockCache::blockSize() const
+    {
+      return bytesPerBlock;
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,146 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "CellBVH.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <numeric>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    static inline float axisValue(const vec3f &v, int axis)
+    {
+      return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+
+    void CellBVH::build(const std::vector<box3f> &cellBounds)
+    {
+      const int numCells = cellBounds.size();
+
+      nodes.clear();
+      cellIDs.resize(numCells);
+      std::iota(cellIDs.begin(), cellIDs.end(), 0);
+
+      if (numCells == 0)
+        return;
+
+      std::vector<vec3f> centroids(numCells);
+
+      tasking::parallel_for(size_t(numCells), [&](size_t i) {
+        centroids[i] = cellBounds[i].center();
+      });
+
+      // Top levels, leaving the ranges at PARALLEL_DEPTH to separate tasks.
+      std::vector<Subtree> subtrees;
+
+      nodes.resize(1);
+      buildRecursive(nodes, 0, 0, numCells, 0,
+                     cellBounds, centroids, &subtrees);
+
+      // Subtrees partition disjoint ranges of 'cellIDs' into nodes of their
+      // own, with the subtree root at index 0.
+      std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+
+      tasking::parallel_for(subtrees.size(), [&](size_t i) {
+        auto &local = subtreeNodes[i];
+        local.resize(1);
+        buildRecursive(local, 0, subtrees[i].begin, subtrees[i].end, 0,
+                       cellBounds, centroids, nullptr);
+      });
+
+      // Append the subtrees, replacing their root by the deferred node.
+      for (size_t i = 0; i < subtrees.size(); ++i) {
+        const auto &local = subtreeNodes[i];
+        const int base    = int(nodes.size()) - 1;
+
+        for (size_t n = 0; n < local.size(); ++n) {
+          Node node = local[n];
+
+          if (node.count == 0)
+            node.offset += base;
+
+          if (n == 0)
+            nodes[subtrees[i].nodeID] = node;
+          else
+            nodes.push_back(node);
+        }
+      }
+    }
+
+    void CellBVH::buildRecursive(std::vector<Node> &nodes,
+                                 int nodeID,
+                                 int begin,
+                                 int end,
+                                 int depth,
+                                 const std::vector<box3f> &cellBounds,
+                                 const std::vector<vec3f> &centroids,
+                                 std::vector<Subtree> *deferred)
+    {
+      if (deferred && depth == PARALLEL_DEPTH) {
+        deferred->push_back({nodeID, begin, end});
+        return;
+      }
+
+      box3f bounds         = empty;
+      box3f centroidBounds = empty;
+
+      for (int i = begin; i < end; ++i) {
+        bounds.extend(cellBounds[cellIDs[i]]);
+        centroidBounds.extend(centroids[cellIDs[i]]);
+      }
+
+      nodes[nodeID].bounds = bounds;
+
+      const vec3f extent = centroidBounds.size();
+
+      int axis = 0;
+      if (extent.y > axisValue(extent, axis)) axis = 1;
+      if (extent.z > axisValue(extent, axis)) axis = 2;
+
+      // Cells sharing a centroid cannot be told apart by splitting.
+      if (end - begin <= LEAF_SIZE || axisValue(extent, axis) <= 0.f) {
+        nodes[nodeID].offset = begin;
+        nodes[nodeID].count  = end - begin;
+        return;
+      }
+
+      const int middle = begin + (end - begin) / 2;
+
+      std::nth_element(cellIDs.begin() + begin,
+                       cellIDs.begin() + middle,
+                       cellIDs.begin() + end,
+                       [&](int a, int b) {
+                         return axisValue(centroids[a], axis) <
+                                axisValue(centroids[b], axis);
+                       });
+
+      const int children = nodes.size();
+      nodes.resize(children + 2);
+
+      nodes[nodeID].offset = children;
+      nodes[nodeID].count  = 0;
+
+      buildRecursive(nodes, children, begin, middle, depth + 1,
+                     cellBounds, centroids, deferred);
+      buildRecursive(nodes, children + 1, middle, end, depth + 1,
+                     cellBounds, centroids, deferred);
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,128 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+// ospray
+#include "ospray/common/OSPCommon.h"
+// std
+#include <vector>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Binary bounding volume hierarchy over the cells of an unstructured
+        volume, for locating the cell containing a point. Nodes split their
+        cells at the median centroid along the longest axis; the top levels
+        are built serially and the subtrees below them in parallel. */
+    struct CellBVH
+    {
+      //! Maximum number of cells in a leaf.
+      static constexpr int LEAF_SIZE = 4;
+
+      struct Node
+      {
+        box3f bounds;
+
+        //! Inner nodes (count == 0): index of the first of two adjacent
+        //! children. Leaves: index of the first of their cells in 'cellIDs'.
+        int offset {0};
+        int count  {0};
+      };
+
+      void build(const std::vector<box3f> &cellBounds);
+
+      //! The first cell whose bounds contain 'point' and which passes
+      //! 'inside(cellID)', or -1 if there is none.
+      template <typename Test>
+      int locate(const vec3f &point, const Test &inside) const;
+
+      // Data //
+
+      std::vector<Node> nodes;
+      std::vector<int>  cellIDs;
+
+    private:
+
+      //! A range of cells whose subtree is built in its own task.
+      struct Subtree
+      {
+        int nodeID;
+        int begin;
+        int end;
+      };
+
+      //! Build the subtree of the cells [begin, end) into 'nodes[nodeID]';
+      //! with 'deferred' set, ranges reaching 'PARALLEL_DEPTH' are only
+      //! recorded there.
+      void buildRecursive(std::vector<Node> &nodes,
+                          int nodeID,
+                          int begin,
+                          int end,
+                          int depth,
+                          const std::vector<box3f> &cellBounds,
+                          const std::vector<vec3f> &centroids,
+                          std::vector<Subtree> *deferred);
+
+      //! Depth below which subtrees are built in parallel.
+      static constexpr int PARALLEL_DEPTH = 6;
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline bool boxContains(const box3f &box, const vec3f &point)
+    {
+      return point.x >= box.lower.x && point.x <= box.upper.x &&
+             point.y >= box.lower.y && point.y <= box.upper.y &&
+             point.z >= box.lower.z && point.z <= box.upper.z;
+    }
+
+    template <typename Test>
+    inline int CellBVH::locate(const vec3f &point, const Test &inside) const
+    {
+      if (nodes.empty())
+        return -1;
+
+      // Median splits keep the tree balanced, well within the stack's depth.
+      int stack[64];
+      int stackSize = 0;
+
+      stack[stackSize++] = 0;
+
+      while (stackSize > 0) {
+        const Node &node = nodes[stack[--stackSize]];
+
+        if (!boxContains(node.bounds, point))
+          continue;
+
+        if (node.count == 0) {
+          stack[stackSize++] = node.offset;
+          stack[stackSize++] = node.offset + 1;
+          continue;
+        }
+
+        for (int i = node.offset; i < node.offset + node.count; ++i) {
+          if (inside(cellIDs[i]))
+            return cellIDs[i];
+        }
+      }
+
+      return -1;
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
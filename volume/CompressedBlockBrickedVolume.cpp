@@ -0,0 +1,556 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+//ospray
+#include "CompressedBlockBrickedVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//! The number of bits used to represent the width of a Block in voxels.
+#define BLOCK_VOXEL_WIDTH_BITCOUNT (6)
+
+//! The number of bits used to represent the width of a brick in voxels.
+#define BRICK_VOXEL_WIDTH_BITCOUNT (2)
+
+//! The number of bits used to represent the width of a block in bricks.
+#define BLOCK_BRICK_WIDTH_BITCOUNT (BLOCK_VOXEL_WIDTH_BITCOUNT - BRICK_VOXEL_WIDTH_BITCOUNT)
+
+//! The width of a block in voxels.
+#define BLOCK_VOXEL_WIDTH (1 << BLOCK_VOXEL_WIDTH_BITCOUNT)
+
+//! The width of a block in bricks.
+#define BLOCK_BRICK_WIDTH (1 << BLOCK_BRICK_WIDTH_BITCOUNT)
+
+//! The bits denoting the offset of a brick within a block.
+#define BLOCK_BRICK_BITMASK (BLOCK_BRICK_WIDTH - 1)
+
+//! The bits denoting the offset of a voxel within a brick.
+#define BRICK_VOXEL_BITMASK ((1 << BRICK_VOXEL_WIDTH_BITCOUNT) - 1)
+
+//! The number of voxels contained in a brick.
+#define BRICK_VOXEL_COUNT (1 << (3 * BRICK_VOXEL_WIDTH_BITCOUNT))
+
+//! The number of bricks contained in a block.
+#define BLOCK_BRICK_COUNT (1 << (3 * BLOCK_BRICK_WIDTH_BITCOUNT))
+
+//! The number of voxels contained in a block.
+#define BLOCK_VOXEL_COUNT (BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH)
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using CBBV = CompressedBlockBrickedVolume;
+
+    static std::atomic<size_t> nextVolumeID {1};
+
+    //! Direct mapped cache of decoded bricks, one per sampling thread.
+    struct DecodedBrickCache
+    {
+      static constexpr int SIZE = 64;
+
+      size_t volumeID   {0};
+      size_t generation {0};
+
+      uint64 tags[SIZE];
+      float  voxels[SIZE][BRICK_VOXEL_COUNT];
+
+      void reset(size_t id, size_t gen)
+      {
+        volumeID   = id;
+        generation = gen;
+        std::fill(tags, tags + SIZE, uint64(-1));
+      }
+
+      static int slot(uint64 tag)
+      {
+        // Mix in the higher bits so bricks neighboring in y and z don't map
+        // to the same slot.
+        return (tag ^ (tag >> 6) ^ (tag >> 12)) & (SIZE - 1);
+      }
+    };
+
+    //! Decoded brick caches of the volumes a sampling thread uses, so
+    //! interleaved sampling of several volumes keeps each one's bricks.
+    struct DecodedBrickCaches
+    {
+      static constexpr int SIZE = 4;
+
+      DecodedBrickCache caches[SIZE];
+      int next {0};
+
+      //! The cache of a volume (reset if its contents changed since), or a
+      //! recycled one if there is none.
+      DecodedBrickCache &find(size_t volumeID, size_t generation)
+      {
+        for (auto &cache : caches) {
+          if (cache.volumeID == volumeID) {
+            if (cache.generation != generation)
+              cache.reset(volumeID, generation);
+            return cache;
+          }
+        }
+
+        DecodedBrickCache &cache = caches[next];
+        next = (next + 1) % SIZE;
+
+        cache.reset(volumeID, generation);
+        return cache;
+      }
+    };
+
+    static thread_local DecodedBrickCaches decodedBricks;
+
+    // CompressedBlockBrickedVolume definitions ///////////////////////////////
+
+    CBBV::CompressedBlockBrickedVolume() : volumeID(nextVolumeID++)
+    {
+    }
+
+    std::string CBBV::toString() const
+    {
+      return("ospray::cpp_renderer::CompressedBBV<" + voxelType + ">");
+    }
+
+    void CBBV::commit()
+    {
+      if (blocks.empty()) constructVolumeMemory();
+
+      // Blocks which were only partially written are compressed now.
+      compressStagingBlocks(true);
+
+      StructuredVolume::commit();
+    }
+
+    int CBBV::setRegion(const void *source,
+                        const vec3i &regionCoords,
+                        const vec3i &regionSize)
+    {
+      if (blocks.empty())
+        constructVolumeMemory();
+
+      // Copy voxel data into the staging blocks, one run of voxels per task.
+      const size_t NTASKS = regionSize.y * regionSize.z;
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<uint8>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_SHORT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<int16>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_USHORT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<uint16>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_FLOAT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<float>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_DOUBLE:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<double>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      default:
+        throw std::runtime_error("No voxel_t specificed in cpp compressed bbv!");
+        break;
+      }
+
+      accumulateStatistics(voxel_t, source, regionCoords, regionSize);
+
+      // Compress the blocks this region completed, so only the blocks still
+      // being written are held uncompressed.
+      compressStagingBlocks(false);
+
+      return true;
+    }
+
+    float CBBV::computeSample(const vec3f &worldCoordinates) const
+    {
+      vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3f clampedLocalCoordinates = clamp(localCoordinates,
+                                                  vec3f{0.0f},
+                                                  localCoordinatesUpperBound);
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {clampedLocalCoordinates.x,
+                        clampedLocalCoordinates.y,
+                        clampedLocalCoordinates.z};
+      const vec3i vi_1 = vi_0 + 1;
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = clampedLocalCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      auto voxel = [&](int x, int y, int z) {
+        return getDecodedVoxel(getVoxelAddress(vec3i{x, y, z}));
+      };
+
+      // "vv" means "voxelValue"
+      const float vv_000 = voxel(vi_0.x, vi_0.y, vi_0.z);
+      const float vv_001 = voxel(vi_1.x, vi_0.y, vi_0.z);
+      const float vv_010 = voxel(vi_0.x, vi_1.y, vi_0.z);
+      const float vv_011 = voxel(vi_1.x, vi_1.y, vi_0.z);
+      const float vv_100 = voxel(vi_0.x, vi_0.y, vi_1.z);
+      const float vv_101 = voxel(vi_1.x, vi_0.y, vi_1.z);
+      const float vv_110 = voxel(vi_0.x, vi_1.y, vi_1.z);
+      const float vv_111 = voxel(vi_1.x, vi_1.y, vi_1.z);
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    size_t CBBV::compressedSize() const
+    {
+      size_t size = 0;
+
+      for (const auto &block : blocks) {
+        size += sizeof(block.range);
+        size += block.brickRange.size();
+        size += block.codes.size();
+      }
+
+      return size;
+    }
+
+    float CBBV::getVoxel(const vec3i &index) const
+    {
+      return getDecodedVoxel(getVoxelAddress(index));
+    }
+
+    float CBBV::getDecodedVoxel(const Address &address) const
+    {
+      auto &cache = decodedBricks.find(volumeID, generation);
+
+      const uint32 brickID = address.voxel >> (3 * BRICK_VOXEL_WIDTH_BITCOUNT);
+      const uint64 tag = (address.block << (3 * BLOCK_BRICK_WIDTH_BITCOUNT))
+                         | brickID;
+      const int slot = DecodedBrickCache::slot(tag);
+
+      if (cache.tags[slot] != tag) {
+        decodeBrick(address.block, brickID, cache.voxels[slot]);
+        cache.tags[slot] = tag;
+      }
+
+      return cache.voxels[slot][address.voxel & (BRICK_VOXEL_COUNT - 1)];
+    }
+
+    void CBBV::decodeBrick(uint64 blockID,
+                           uint32 brickID,
+                           float *voxels) const
+    {
+      const auto &block = blocks[blockID];
+
+      if (block.codes.empty()) {
+        std::fill(voxels, voxels + BRICK_VOXEL_COUNT, 0.f);
+        return;
+      }
+
+      const vec2f range = getBrickRange(block, brickID);
+      const size_t first = size_t(brickID) * BRICK_VOXEL_COUNT;
+
+      if (quantizationBits == 8) {
+        const uint8 *codes = block.codes.data() + first;
+        for (int i = 0; i < BRICK_VOXEL_COUNT; ++i)
+          voxels[i] = range.x + codes[i] * range.y;
+      } else {
+        const uint8 *codes = block.codes.data() + first / 2;
+        for (int i = 0; i < BRICK_VOXEL_COUNT; ++i) {
+          const int code = (codes[i / 2] >> (4 * (i & 1))) & 15;
+          voxels[i] = range.x + code * range.y;
+        }
+      }
+    }
+
+    template <typename T>
+    void CBBV::setVoxelValues(const void *source,
+                              const vec3i &targetCoord000,
+                              const vec3i &regionSize,
+                              size_t taskIndex)
+    {
+      const uint32 region_y = taskIndex % regionSize.y;
+      const uint32 region_z = taskIndex / regionSize.y;
+      const uint64 runOfs = (uint64)regionSize.x *
+                            (region_y + (uint64)regionSize.y * region_z);
+      const T *run = (const T *)source + runOfs;
+      vec3i coord = targetCoord000 + vec3i{0, region_y, region_z};
+
+      if (coord.y < 0 || coord.z < 0 ||
+          coord.y >= dimensions.y || coord.z >= dimensions.z)
+        return;
+
+      StagingBlock *block = nullptr;
+      uint64 blockID = 0;
+      size_t covered = 0;
+
+      for (int x = 0; x < regionSize.x; ++x) {
+        coord.x = targetCoord000.x + x;
+        if (coord.x < 0 || coord.x >= dimensions.x)
+          continue;
+
+        const Address address = getVoxelAddress(coord);
+
+        if (!block || address.block != blockID) {
+          if (block)
+            block->voxelsCovered += covered;
+
+          blockID = address.block;
+          block   = &getStagingBlock(blockID);
+          covered = 0;
+        }
+
+        block->voxels[address.voxel] = float(run[x]);
+
+        // Rewriting a voxel must not count towards completing the block.
+        if (!block->written[address.voxel]) {
+          block->written[address.voxel] = 1;
+          covered++;
+        }
+      }
+
+      if (block)
+        block->voxelsCovered += covered;
+    }
+
+    CBBV::StagingBlock &CBBV::getStagingBlock(uint64 blockID)
+    {
+      std::lock_guard<std::mutex> lock(stagingMutex);
+
+      auto &staging = stagingBlocks[blockID];
+
+      if (!staging) {
+        staging.reset(new StagingBlock);
+        staging->voxels.resize(BLOCK_VOXEL_COUNT);
+        staging->written.assign(BLOCK_VOXEL_COUNT, 0);
+
+        // Rewriting part of an already compressed block starts from its
+        // decoded voxels.
+        for (uint32 brickID = 0; brickID < BLOCK_BRICK_COUNT; ++brickID) {
+          decodeBrick(blockID, brickID,
+                      staging->voxels.data() + brickID * BRICK_VOXEL_COUNT);
+        }
+      }
+
+      return *staging;
+    }
+
+    void CBBV::compressStagingBlocks(bool all)
+    {
+      std::vector<uint64> finished;
+
+      for (uint64 blockID = 0; blockID < stagingBlocks.size(); ++blockID) {
+        const auto &staging = stagingBlocks[blockID];
+        if (staging &&
+            (all || staging->voxelsCovered >= numVoxelsInBlock(blockID))) {
+          finished.push_back(blockID);
+        }
+      }
+
+      tasking::parallel_for(finished.size(), [&](size_t i) {
+        const uint64 blockID = finished[i];
+        compressBlock(blockID, stagingBlocks[blockID]->voxels);
+        stagingBlocks[blockID].reset();
+      });
+
+      // Invalidate the bricks decoded by sampling threads.
+      if (!finished.empty())
+        generation++;
+    }
+
+    void CBBV::compressBlock(uint64 blockID, const std::vector<float> &voxels)
+    {
+      auto &block = blocks[blockID];
+
+      const int levels = (1 << quantizationBits) - 1;
+
+      // Non-finite voxels take no part in the ranges and decode to the lower
+      // bound of their brick.
+      auto finiteRange = [](const float *begin, const float *end) {
+        vec2f range {FLT_MAX, -FLT_MAX};
+        for (const float *v = begin; v != end; ++v) {
+          if (std::isfinite(*v)) {
+            range.x = std::min(range.x, *v);
+            range.y = std::max(range.y, *v);
+          }
+        }
+        return range;
+      };
+
+      block.range = finiteRange(voxels.data(), voxels.data() + voxels.size());
+      if (block.range.x > block.range.y)
+        block.range = vec2f{0.f};
+
+      const float blockStep = (block.range.y - block.range.x) / 255.f;
+      const float rcpBlockStep = (blockStep > 0.f) ? 1.f / blockStep : 0.f;
+
+      block.brickRange.resize(2 * BLOCK_BRICK_COUNT);
+      block.codes.assign(BLOCK_VOXEL_COUNT * quantizationBits / 8, 0);
+
+      for (int brickID = 0; brickID < BLOCK_BRICK_COUNT; ++brickID) {
+        const float *brick = voxels.data() + brickID * BRICK_VOXEL_COUNT;
+
+        vec2f brickRange = finiteRange(brick, brick + BRICK_VOXEL_COUNT);
+        if (brickRange.x > brickRange.y)
+          brickRange = vec2f{block.range.x};
+
+        // Widen the brick's range outwards to the block's 8-bit grid.
+        const float lower = (brickRange.x - block.range.x) * rcpBlockStep;
+        const float upper = (brickRange.y - block.range.x) * rcpBlockStep;
+
+        block.brickRange[2 * brickID] =
+            uint8(clamp(std::floor(lower), 0.f, 255.f));
+        block.brickRange[2 * brickID + 1] =
+            uint8(clamp(std::ceil(upper), 0.f, 255.f));
+
+        const vec2f range = getBrickRange(block, brickID);
+        const float rcpStep = (range.y > 0.f) ? 1.f / range.y : 0.f;
+
+        for (int i = 0; i < BRICK_VOXEL_COUNT; ++i) {
+          const float value = std::isfinite(brick[i]) ?
+              (brick[i] - range.x) * rcpStep + 0.5f : 0.f;
+          const int code = int(clamp(value, 0.f, float(levels)));
+          const size_t v = size_t(brickID) * BRICK_VOXEL_COUNT + i;
+
+          if (quantizationBits == 8)
+            block.codes[v] = code;
+          else
+            block.codes[v / 2] |= code << (4 * (v & 1));
+        }
+      }
+    }
+
+    vec2f CBBV::getBrickRange(const CompressedBlock &block,
+                              uint32 brickID) const
+    {
+      const int levels = (1 << quantizationBits) - 1;
+
+      const float blockStep = (block.range.y - block.range.x) / 255.f;
+      const float lower = block.range.x
+                          + block.brickRange[2 * brickID] * blockStep;
+      const float upper = block.range.x
+                          + block.brickRange[2 * brickID + 1] * blockStep;
+
+      return vec2f{lower, (upper - lower) / levels};
+    }
+
+    size_t CBBV::numVoxelsInBlock(uint64 blockID) const
+    {
+      const vec3i blockIndex {
+        int(blockID % blockCount.x),
+        int((blockID / blockCount.x) % blockCount.y),
+        int(blockID / (uint64(blockCount.x) * blockCount.y))
+      };
+
+      const vec3i lower = blockIndex * BLOCK_VOXEL_WIDTH;
+      const vec3i upper = min(lower + BLOCK_VOXEL_WIDTH, dimensions);
+      const vec3i size  = upper - lower;
+
+      return size_t(size.x) * size.y * size.z;
+    }
+
+    size_t CBBV::brickID(const vec3f &worldCoordinates) const
+    {
+      const Address address = getVoxelAddress(voxelIndex(worldCoordinates));
+
+      // The voxel address holds the brick address above the voxel offset.
+      return (size_t(address.block) << (3 * BLOCK_BRICK_WIDTH_BITCOUNT))
+             | (address.voxel >> (3 * BRICK_VOXEL_WIDTH_BITCOUNT));
+    }
+
+    CBBV::Address CBBV::getVoxelAddress(const vec3i &index) const
+    {
+      Address address;
+
+      // Compute the 1D address of the block in the volume.
+      address.block = (index.x >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+        + blockCount.x * ((index.y >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+                          + uint64(blockCount.y)
+                            * (index.z >> BLOCK_VOXEL_WIDTH_BITCOUNT));
+
+      // Compute the 1D address of the brick in the block.
+      const uint32 brickAddress
+        = ((index.x >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+        + (((index.y >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << BLOCK_BRICK_WIDTH_BITCOUNT)
+        + (((index.z >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << 2 * BLOCK_BRICK_WIDTH_BITCOUNT);
+
+      // Compute the 1D address of the voxel in the block.
+      address.voxel
+        = brickAddress << (3 * BRICK_VOXEL_WIDTH_BITCOUNT)
+        | (index.z & BRICK_VOXEL_BITMASK) << (2 * BRICK_VOXEL_WIDTH_BITCOUNT)
+        | (index.y & BRICK_VOXEL_BITMASK) << BRICK_VOXEL_WIDTH_BITCOUNT
+        | (index.x & BRICK_VOXEL_BITMASK);
+
+      return address;
+    }
+
+    void CBBV::constructVolumeMemory()
+    {
+      // Get the voxel type.
+      voxelType = getParamString("voxelType", "unspecified");
+      voxel_t   = getVoxelType();
+
+      // 8-bit codes plus the brick ranges are larger than uchar voxels.
+      const int defaultBits = (voxel_t == OSP_UCHAR) ? 4 : 8;
+      quantizationBits =
+          getParam1i("quantizationBits", defaultBits) <= 4 ? 4 : 8;
+      exitOnCondition(voxel_t == OSP_UCHAR && quantizationBits == 8,
+                      "8-bit quantization does not compress uchar volumes, "
+                      "use 4 bits or a block bricked volume");
+
+      // Get the volume dimensions.
+      this->dimensions = getParam3i("dimensions", vec3i(0));
+      exitOnCondition(reduce_min(this->dimensions) <= 0,
+                      "invalid volume dimensions (must be set before "
+                      "calling ospSetRegion())");
+
+      // Volume size in blocks per dimension with padding to the nearest block
+      blockCount = (dimensions + BLOCK_VOXEL_WIDTH - 1) / BLOCK_VOXEL_WIDTH;
+
+      const size_t numBlocks =
+          size_t(blockCount.x) * blockCount.y * blockCount.z;
+
+      blocks.clear();
+      blocks.resize(numBlocks);
+
+      stagingBlocks.clear();
+      stagingBlocks.resize(numBlocks);
+
+      generation++;
+    }
+
+    // A block bricked volume with per-brick quantized voxels.
+    OSP_REGISTER_VOLUME(CompressedBlockBrickedVolume, cpp_compressed_bbv);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,152 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "StructuredVolume.h"
+// std
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Block bricked volume storing each 4^3 brick quantized against its own
+        value range (8 or 4 bits per voxel, 4 for uchar sources), so the error
+        of any voxel is at most half a quantization step of its brick. Brick
+        ranges take 2 bytes, relative to the range of their block. Bricks are
+        decoded on demand through small per-thread, per-volume caches of
+        decoded bricks. */
+    class CompressedBlockBrickedVolume : public StructuredVolume
+    {
+    public:
+
+      CompressedBlockBrickedVolume();
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      //! The block and the brick within it holding the voxel at
+      //! 'worldCoordinates', in the order they are laid out in memory.
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+      //! Size of the compressed voxel data in bytes.
+      size_t compressedSize() const;
+
+    private:
+
+      // Helper types //
+
+      struct Address
+      {
+        //! The 1D address of the block in the volume containing the voxel.
+        uint64 block;
+
+        //! The 1D offset of the voxel in the enclosing block.
+        uint32 voxel;
+      };
+
+      struct CompressedBlock
+      {
+        //! Range of the finite voxels of the block.
+        vec2f range {0.f};
+
+        //! Per brick (lower, upper) bounds, quantized to 8 bits across
+        //! 'range' (rounded outwards).
+        std::vector<uint8> brickRange;
+
+        //! Quantized voxels, in the same order as the uncompressed block.
+        std::vector<uint8> codes;
+      };
+
+      //! Uncompressed copy of a block while it is being written.
+      struct StagingBlock
+      {
+        std::vector<float> voxels;
+
+        //! Per voxel flag set once the voxel was written, each voxel is
+        //! written by a single task of a setRegion() call.
+        std::vector<uint8> written;
+
+        //! Number of distinct voxels written so far.
+        std::atomic<size_t> voxelsCovered {0};
+      };
+
+      // StructuredVolume interface //
+
+      float getVoxel(const vec3i &index) const override;
+
+      // Helper functions //
+
+      float getDecodedVoxel(const Address &address) const;
+
+      void decodeBrick(uint64 blockID, uint32 brickID, float *voxels) const;
+
+      //! (lower bound, quantization step) of a brick.
+      vec2f getBrickRange(const CompressedBlock &block, uint32 brickID) const;
+
+      template <typename T>
+      void setVoxelValues(const void *source,
+                          const vec3i &targetCoord000,
+                          const vec3i &regionSize,
+                          size_t taskIndex);
+
+      StagingBlock &getStagingBlock(uint64 blockID);
+
+      //! Compress staged blocks, either all or only the completely written.
+      void compressStagingBlocks(bool all);
+
+      void compressBlock(uint64 blockID, const std::vector<float> &voxels);
+
+      //! Number of voxels of a block which lie inside the volume.
+      size_t numVoxelsInBlock(uint64 blockID) const;
+
+      Address getVoxelAddress(const vec3i &index) const;
+
+      void constructVolumeMemory();
+
+      // Data //
+
+      //! Volume size in blocks per dimension with padding to the nearest block.
+      vec3i blockCount;
+
+      //! Voxel type of the source data.
+      OSPDataType voxel_t {OSP_UNKNOWN};
+
+      //! Bits per quantized voxel (8 or 4).
+      int quantizationBits {8};
+
+      std::vector<CompressedBlock> blocks;
+
+      std::vector<std::unique_ptr<StagingBlock>> stagingBlocks;
+      std::mutex stagingMutex;
+
+      //! Identify this volume and its current contents for decoded bricks
+      //! cached by the sampling threads.
+      size_t volumeID;
+      size_t generation {0};
+    };
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
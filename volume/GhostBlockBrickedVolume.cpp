@@ -17,6 +17,10 @@
 //ospray
 #include "GhostBlockBrickedVolume.h"
 #include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 
 /*! total number of bits per block dimension. '6' would mean 18 bits =
   1/4million voxels per block, which for alots would be 1MB, so should
@@ -223,51 +227,51 @@ namespace ospray {
 
       const bool upsampling = scaleRegion(source, finalSource,
                                           finalRegionSize, finalRegionCoords);
-      // Copy voxel data into the volume.
-      const size_t NTASKS = finalRegionSize.y * finalRegionSize.z;
 
       if (voxel_t == OSP_UNKNOWN)
         constructVolumeMemory();
 
+      // Copy voxel data into the volume, one task per block overlapped by the
+      // part of the region which lies inside of the volume. Voxels on a block
+      // boundary are stored by every block sharing them, each task copying
+      // its own ghost layer straight from the source.
+      const box3i target {max(finalRegionCoords, vec3i(0)),
+                          min(finalRegionCoords + finalRegionSize, dimensions)};
+
+      const box3i blocks = blocksOverlapping(target);
+      const vec3i blockRange = max(blocks.upper - blocks.lower, vec3i(0));
+
+      const size_t NTASKS = size_t(blockRange.x) * blockRange.y * blockRange.z;
+
       switch (voxel_t) {
       case OSP_UCHAR:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<uint8, VOXELS_PER_BLOCK>(finalSource,
-                                                  finalRegionCoords,
-                                                  finalRegionSize,
-                                                  taskIndex);
+          setBlockValues<uint8>(finalSource, finalRegionCoords,
+                                finalRegionSize, target, taskIndex);
         });
         break;
       case OSP_SHORT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<int16, VOXELS_PER_BLOCK>(finalSource,
-                                                  finalRegionCoords,
-                                                  finalRegionSize,
-                                                  taskIndex);
+          setBlockValues<int16>(finalSource, finalRegionCoords,
+                                finalRegionSize, target, taskIndex);
         });
         break;
       case OSP_USHORT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<uint16, VOXELS_PER_BLOCK>(finalSource,
-                                                   finalRegionCoords,
-                                                   finalRegionSize,
-                                                   taskIndex);
+          setBlockValues<uint16>(finalSource, finalRegionCoords,
+                                 finalRegionSize, target, taskIndex);
         });
         break;
       case OSP_FLOAT:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<float, VOXELS_PER_BLOCK>(finalSource,
-                                                  finalRegionCoords,
-                                                  finalRegionSize,
-                                                  taskIndex);
+          setBlockValues<float>(finalSource, finalRegionCoords,
+                                finalRegionSize, target, taskIndex);
         });
         break;
       case OSP_DOUBLE:
         tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
-          setVoxelValues<double, VOXELS_PER_BLOCK>(finalSource,
-                                                   finalRegionCoords,
-                                                   finalRegionSize,
-                                                   taskIndex);
+          setBlockValues<double>(finalSource, finalRegionCoords,
+                                 finalRegionSize, target, taskIndex);
         });
         break;
       default:
@@ -275,6 +279,9 @@ namespace ospray {
         break;
       }
 
+      accumulateStatistics(voxel_t, finalSource,
+                           finalRegionCoords, finalRegionSize);
+
       // If we're upsampling finalSource points at the chunk of data allocated by
       // scaleRegion to hold the upsampled volume data and we must free it.
       if (upsampling) {
@@ -286,7 +293,30 @@ namespace ospray {
 
     float GhostBlockBrickedVolume::getVoxel(const vec3i &index) const
     {
-      NOT_IMPLEMENTED// NOTE(jda) - not needed...
+      // Not used for sampling, but needed to build accelerators
+      const Address address = getIndices(index);
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        return getVoxelValue<uint8, VOXELS_PER_BLOCK>(address);
+        break;
+      case OSP_SHORT:
+        return getVoxelValue<int16, VOXELS_PER_BLOCK>(address);
+        break;
+      case OSP_USHORT:
+        return getVoxelValue<uint16, VOXELS_PER_BLOCK>(address);
+        break;
+      case OSP_FLOAT:
+        return getVoxelValue<float, VOXELS_PER_BLOCK>(address);
+        break;
+      case OSP_DOUBLE:
+        return getVoxelValue<double, VOXELS_PER_BLOCK>(address);
+        break;
+      default:
+        break;
+      }
+
+      return inf;
     }
 
     float
@@ -380,6 +410,174 @@ namespace ospray {
       return val;
     }
 
+    simd::vfloat
+    GhostBlockBrickedVolume::computeSample(simd::vmaski active,
+                                           const simd::vec3f &worldCoordinates)
+                                           const
+    {
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        return computeSample_T<uint8>(active, worldCoordinates);
+        break;
+      case OSP_SHORT:
+        return computeSample_T<int16>(active, worldCoordinates);
+        break;
+      case OSP_USHORT:
+        return computeSample_T<uint16>(active, worldCoordinates);
+        break;
+      case OSP_FLOAT:
+        return computeSample_T<float>(active, worldCoordinates);
+        break;
+      case OSP_DOUBLE:
+        return computeSample_T<double>(active, worldCoordinates);
+        break;
+      default:
+        break;
+      }
+
+      return simd::vfloat{inf};
+    }
+
+    template<typename T>
+    simd::vfloat
+    GhostBlockBrickedVolume::computeSample_T(simd::vmaski active,
+                                             const simd::vec3f &worldCoordinates)
+                                             const
+    {
+      /* Transform the sample location into the local coordinate system, with
+         coordinates outside the volume clamped to the volume bounds. */
+      const simd::vec3f clampedLocalCoordinates =
+          clampLocal(transformWorldToLocal(worldCoordinates));
+
+      // "vi" means "voxelIndex"
+      const simd::vec3i vi_0 {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z)
+      };
+
+      const simd::vec3f flc {
+        clampedLocalCoordinates.x - simd::cast<simd::vfloat>(vi_0.x),
+        clampedLocalCoordinates.y - simd::cast<simd::vfloat>(vi_0.y),
+        clampedLocalCoordinates.z - simd::cast<simd::vfloat>(vi_0.z)
+      };
+
+      /* Vectorized getVoxelAddress(): block index via fast float division,
+         then the bricked offset of the lower corner and the deltas to its
+         +1 neighbors (see brickTranslation()). */
+      constexpr float rcpBlockWidth = 1.f / (BLOCK_WIDTH - 1.f);
+
+      const simd::vec3i blockIndex {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x * rcpBlockWidth),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y * rcpBlockWidth),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z * rcpBlockWidth)
+      };
+
+      const simd::vint block = blockIndex.x
+                               + blockCount.x * (blockIndex.y
+                                                 + blockCount.y * blockIndex.z);
+
+      const simd::vec3i voxelIdxInBlock {
+        vi_0.x - blockIndex.x * (BLOCK_WIDTH - 1),
+        vi_0.y - blockIndex.y * (BLOCK_WIDTH - 1),
+        vi_0.z - blockIndex.z * (BLOCK_WIDTH - 1)
+      };
+
+      const simd::vec3i brickIdxInBlock {voxelIdxInBlock.x >> BRICK_BITS,
+                                         voxelIdxInBlock.y >> BRICK_BITS,
+                                         voxelIdxInBlock.z >> BRICK_BITS};
+      const simd::vec3i voxelIdxInBrick {voxelIdxInBlock.x & BRICK_MASK,
+                                         voxelIdxInBlock.y & BRICK_MASK,
+                                         voxelIdxInBlock.z & BRICK_MASK};
+
+      constexpr int scale = scale_per<T>::value;
+      constexpr int shift = shift_per<T>::value;
+
+      auto delta = [&](const simd::vint &idxInBrick, int scaleLo, int scaleHi) {
+        return simd::select(idxInBrick == (BRICK_WIDTH-1),
+                            simd::vint{(scaleHi - (BRICK_WIDTH-1)*scaleLo)
+                                       * scale},
+                            simd::vint{scaleLo * scale});
+      };
+
+      const simd::vint voxelOfs_dx =
+          delta(voxelIdxInBrick.x, BRICK_BIT_SCALE_X_LO, BRICK_BIT_SCALE_X_HI);
+      const simd::vint voxelOfs_dy =
+          delta(voxelIdxInBrick.y, BRICK_BIT_SCALE_Y_LO, BRICK_BIT_SCALE_Y_HI);
+      const simd::vint voxelOfs_dz =
+          delta(voxelIdxInBrick.z, BRICK_BIT_SCALE_Z_LO, BRICK_BIT_SCALE_Z_HI);
+
+      const simd::vint ofs000 =
+        (voxelIdxInBrick.x << (BRICK_BIT_X_LO+shift)) |
+        (voxelIdxInBrick.y << (BRICK_BIT_Y_LO+shift)) |
+        (voxelIdxInBrick.z << (BRICK_BIT_Z_LO+shift)) |
+        (brickIdxInBlock.x << (BRICK_BIT_X_HI+shift)) |
+        (brickIdxInBlock.y << (BRICK_BIT_Y_HI+shift)) |
+        (brickIdxInBlock.z << (BRICK_BIT_Z_HI+shift));
+
+      const simd::vint ofs001 = ofs000 + voxelOfs_dx;
+      const simd::vint ofs010 = ofs000 + voxelOfs_dy;
+      const simd::vint ofs011 = ofs001 + voxelOfs_dy;
+      const simd::vint ofs100 = ofs000 + voxelOfs_dz;
+      const simd::vint ofs101 = ofs001 + voxelOfs_dz;
+      const simd::vint ofs110 = ofs010 + voxelOfs_dz;
+      const simd::vint ofs111 = ofs011 + voxelOfs_dz;
+
+      simd::vfloat val000 {0.f}, val001 {0.f}, val010 {0.f}, val011 {0.f};
+      simd::vfloat val100 {0.f}, val101 {0.f}, val110 {0.f}, val111 {0.f};
+
+      if (std::is_same<T, float>::value && gatherVoxels) {
+        /* Float voxels of volumes addressable with 32-bit offsets are
+           gathered for all active lanes at once, the bricked offsets are in
+           bytes. */
+        const float *voxels   = (const float*)blockMem;
+        const simd::vint base = block * VOXELS_PER_BLOCK;
+
+        simd::gather(val000, voxels, base + (ofs000 >> shift), active);
+        simd::gather(val001, voxels, base + (ofs001 >> shift), active);
+        simd::gather(val010, voxels, base + (ofs010 >> shift), active);
+        simd::gather(val011, voxels, base + (ofs011 >> shift), active);
+        simd::gather(val100, voxels, base + (ofs100 >> shift), active);
+        simd::gather(val101, voxels, base + (ofs101 >> shift), active);
+        simd::gather(val110, voxels, base + (ofs110 >> shift), active);
+        simd::gather(val111, voxels, base + (ofs111 >> shift), active);
+      } else {
+        /* Other voxel types (converted to float on load) and volumes needing
+           64-bit offsets are loaded per lane. */
+        simd::foreach_active(active, [&](int i) {
+          const T *blockPtr = (const T*)blockMem
+                              + ((uint64)(uint32)block[i]) * VOXELS_PER_BLOCK;
+          val000[i] = accessArrayWithOffset(blockPtr, ofs000[i]);
+          val001[i] = accessArrayWithOffset(blockPtr, ofs001[i]);
+          val010[i] = accessArrayWithOffset(blockPtr, ofs010[i]);
+          val011[i] = accessArrayWithOffset(blockPtr, ofs011[i]);
+          val100[i] = accessArrayWithOffset(blockPtr, ofs100[i]);
+          val101[i] = accessArrayWithOffset(blockPtr, ofs101[i]);
+          val110[i] = accessArrayWithOffset(blockPtr, ofs110[i]);
+          val111[i] = accessArrayWithOffset(blockPtr, ofs111[i]);
+        });
+      }
+
+      /* Interpolate the voxel values. */
+      const auto val00 = val000 + flc.x * (val001 - val000);
+      const auto val01 = val010 + flc.x * (val011 - val010);
+      const auto val10 = val100 + flc.x * (val101 - val100);
+      const auto val11 = val110 + flc.x * (val111 - val110);
+      const auto val0  = val00  + flc.y * (val01  - val00 );
+      const auto val1  = val10  + flc.y * (val11  - val10 );
+
+      return val0 + flc.z * (val1 - val0);
+    }
+
+    size_t GBBV::brickID(const vec3f &worldCoordinates) const
+    {
+      const Address address = getIndices(voxelIndex(worldCoordinates));
+
+      // The voxel address holds the brick address above the voxel offset.
+      return (size_t(address.block) << (3 * (BLOCK_BITS - BRICK_BITS)))
+             | (address.voxel >> (3 * BRICK_BITS));
+    }
+
     Address GhostBlockBrickedVolume::getIndices(const vec3i &voxelIdxInVolume) const
     {
       Address address;
@@ -478,6 +676,85 @@ namespace ospray {
              && (blockIndex.z >= 0);
     }
 
+    box3i GBBV::blocksOverlapping(const box3i &target) const
+    {
+      if (reduce_min(target.upper - target.lower) <= 0)
+        return box3i(vec3i(0), vec3i(0));
+
+      // Block 'b' holds the voxels [b*(BLOCK_WIDTH-1), (b+1)*(BLOCK_WIDTH-1)].
+      const vec3i lower = max(target.lower - 1, vec3i(0)) / (BLOCK_WIDTH-1);
+      const vec3i upper = min((target.upper - 1) / (BLOCK_WIDTH-1),
+                              blockCount - 1) + 1;
+
+      return box3i(lower, upper);
+    }
+
+    template <typename T>
+    void GBBV::setBlockValues(const void *_source,
+                              const vec3i &regionCoords,
+                              const vec3i &regionSize,
+                              const box3i &target,
+                              size_t taskIndex)
+    {
+      const box3i blocks = blocksOverlapping(target);
+      const vec3i blockRange = blocks.upper - blocks.lower;
+
+      const vec3i blockIndex = blocks.lower
+        + vec3i(taskIndex % blockRange.x,
+                (taskIndex / blockRange.x) % blockRange.y,
+                taskIndex / (size_t(blockRange.x) * blockRange.y));
+
+      const uint32 block = blockIndex.x
+        + blockCount.x * (blockIndex.y + blockCount.y * blockIndex.z);
+
+      T *blockPtr = (T*)blockMem + uint64(block) * VOXELS_PER_BLOCK;
+
+      // The voxels of the target region inside of this block, in block space.
+      const vec3i blockLower = blockIndex * (BLOCK_WIDTH-1);
+      const vec3i lower = max(target.lower, blockLower) - blockLower;
+      const vec3i upper = min(target.upper, blockLower + BLOCK_WIDTH)
+                          - blockLower;
+
+      const T *source = (const T*)_source;
+      const vec3i sourceOrigin = blockLower - regionCoords;
+      const uint64 sliceSize = uint64(regionSize.x) * regionSize.y;
+
+      // Visit the bricks in memory order so the block is written front to
+      // back; a brick row is contiguous both in the source and in the block.
+      const vec3i firstBrick {lower.x & ~BRICK_MASK,
+                              lower.y & ~BRICK_MASK,
+                              lower.z & ~BRICK_MASK};
+
+      for (int bz = firstBrick.z; bz < upper.z; bz += BRICK_WIDTH) {
+        for (int by = firstBrick.y; by < upper.y; by += BRICK_WIDTH) {
+          for (int bx = firstBrick.x; bx < upper.x; bx += BRICK_WIDTH) {
+            const int x0 = std::max(bx, lower.x);
+            const int x1 = std::min(bx + BRICK_WIDTH, upper.x);
+            const int y1 = std::min(by + BRICK_WIDTH, upper.y);
+            const int z1 = std::min(bz + BRICK_WIDTH, upper.z);
+
+            for (int z = std::max(bz, lower.z); z < z1; ++z) {
+              for (int y = std::max(by, lower.y); y < y1; ++y) {
+                const T *run = source + (sourceOrigin.x + x0)
+                  + uint64(sourceOrigin.y + y) * regionSize.x
+                  + uint64(sourceOrigin.z + z) * sliceSize;
+
+                const uint32 voxel =
+                  ((x0 & BRICK_MASK) << BRICK_BIT_X_LO) |
+                  ((y  & BRICK_MASK) << BRICK_BIT_Y_LO) |
+                  ((z  & BRICK_MASK) << BRICK_BIT_Z_LO) |
+                  ((x0 >> BRICK_BITS) << BRICK_BIT_X_HI) |
+                  ((y  >> BRICK_BITS) << BRICK_BIT_Y_HI) |
+                  ((z  >> BRICK_BITS) << BRICK_BIT_Z_HI);
+
+                std::copy(run, run + (x1 - x0), blockPtr + voxel);
+              }
+            }
+          }
+        }
+      }
+    }
+
     Address8 GBBV::getVoxelAddress(const vec3f &indexf,
                                    const vec3i &indexi) const
     {
@@ -545,6 +822,9 @@ namespace ospray {
       // allocate the large array of blocks
       size_t blockSize = VOXELS_PER_BLOCK * voxelSize;
       blockMem = new byte_t[blockSize * numBlocks];
+
+      gatherVoxels = uint64(numBlocks) * VOXELS_PER_BLOCK
+                     <= uint64(std::numeric_limits<int>::max());
     }
 
     void GhostBlockBrickedVolume::freeVolumeMemory()
@@ -65,6 +65,11 @@ namespace ospray {
                     const vec3i &index,
                     const vec3i &count) override;
 
+      //! The block and the brick within it holding the voxel at
+      //! 'worldCoordinates', in the order they are laid out in memory (blocks
+      //! overlap by their ghost layer).
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
     private:
 
       // StructuredVolume interface //
@@ -74,17 +79,30 @@ namespace ospray {
       template <typename T>
       float computeSample_T(const vec3f &worldCoordinates) const;
 
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+      template <typename T>
+      simd::vfloat computeSample_T(simd::vmaski active,
+                                   const simd::vec3f &worldCoordinates) const;
+
       // Helper functions //
 
       template <typename T, size_t BLOCK_VOXEL_COUNT>
       float getVoxelValue(const Address &address) const;
 
-      template <typename T, size_t BLOCK_VOXEL_COUNT>
-      void setVoxelValues(void *_source,
-                          const vec3i &targetCoord000,
+      //! Copy the part of a region overlapping one block (including the
+      //! ghost layer it shares with its upper neighbors), brick by brick.
+      template <typename T>
+      void setBlockValues(const void *source,
+                          const vec3i &regionCoords,
                           const vec3i &regionSize,
+                          const box3i &target,
                           size_t taskIndex);
 
+      //! The range of blocks whose voxels (ghosts included) overlap 'target'.
+      box3i blocksOverlapping(const box3i &target) const;
+
       Address  getIndices(const vec3i &voxelIdxInVolume) const;
       bool getGhostIndices(const vec3i &voxelIdxInVolume,
                            const vec3i &delta,
@@ -108,6 +126,9 @@ namespace ospray {
       //! Voxel size in bytes.
       size_t voxelSize;
 
+      //! Voxel offsets fit in 32 bits, so packets gather their voxels.
+      bool gatherVoxels {false};
+
     };
 
     // Inlined definitions ////////////////////////////////////////////////////
@@ -116,55 +137,9 @@ namespace ospray {
     inline float
     GhostBlockBrickedVolume::getVoxelValue(const Address &address) const
     {
-      NOT_IMPLEMENTED
-    }
-
-    template<typename T, size_t VOXELS_PER_BLOCK>
-    inline void
-    GhostBlockBrickedVolume::setVoxelValues(void *_source,
-                                            const vec3i &targetCoord000,
-                                            const vec3i &regionSize,
-                                            size_t taskIndex)
-    {
-      const T *source = (const T*)_source;
-      const uint32 region_y = taskIndex % regionSize.y;
-      const uint32 region_z = taskIndex / regionSize.y;
-      const uint64 runOfs
-        = (uint64)regionSize.x
-        * (region_y + (uint64)regionSize.y * region_z);
-      const T *run = source + runOfs;
-
-      vec3i coord = targetCoord000 + vec3i{0, region_y, region_z};
-      for (int x = 0; x < regionSize.x; ++x) {
-        coord.x = targetCoord000.x + x;
-        if (coord.x < 0 ||
-            coord.y < 0 ||
-            coord.z < 0 ||
-            coord.x >= dimensions.x ||
-            coord.y >= dimensions.y ||
-            coord.z >= dimensions.z)
-          continue;
-
-        auto address = getIndices(coord);
-
-        /* set voxel itself */
-        T *blockPtr = ((T*)blockMem) + address.block * (uint64)VOXELS_PER_BLOCK;
-        blockPtr[address.voxel] = run[x];
-
-        /* copy voxel to end of lower/left/front block if it's on the boundary */
-        for (int32 iz = 0; iz < 2 ; iz++) {
-          for (int32 iy = 0; iy < 2; iy++) {
-            for (int32 ix = 0; ix < 2; ix++) {
-              if (getGhostIndices(coord, vec3i{ix,iy,iz}, address)) {
-                T *blockPtr = ((T*)blockMem)
-                              + (uint64)address.block*(uint64)VOXELS_PER_BLOCK;
-                blockPtr[address.voxel] = run[x];
-              }
-            }
-          }
-        }
-
-      }// foreach
+      const T *blockPtr = (const T*)blockMem
+                          + (uint64)BLOCK_VOXEL_COUNT * address.block;
+      return float(blockPtr[address.voxel]);
     }
 
   } // ::ospray::cpp_renderer
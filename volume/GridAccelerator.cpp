@@ -0,0 +1,35 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "GridAccelerator.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    void GridAccelerator::resize(const vec3i &dimensions)
+    {
+      volumeDimensions = dimensions;
+
+      // Cells cover the voxel *intervals*, so a volume of N voxels has N-1
+      // cells worth of space to partition.
+      cellCount = max(vec3i{1},
+                      (dimensions - 1 + CELL_WIDTH - 1) / CELL_WIDTH);
+
+      cellRange.assign(numCells(), vec2f{FLT_MAX, -FLT_MAX});
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
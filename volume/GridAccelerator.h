@@ -0,0 +1,114 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "../transferFunction/TransferFunction.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! macrocell grid over a structured volume: each cell stores the range of
+        voxel values which can be interpolated anywhere inside of it, so ray
+        marchers can skip cells that the transfer function makes invisible */
+    struct GridAccelerator
+    {
+      //! The width of a cell in voxels (neighboring cells share a voxel layer).
+      static constexpr int CELL_WIDTH = 8;
+
+      void resize(const vec3i &volumeDimensions);
+
+      size_t numCells() const;
+
+      vec3i  cellIndex(size_t cellID) const;
+      size_t cellID(const vec3i &cellIndex) const;
+
+      //! The cell containing the given local (voxel space) coordinates.
+      vec3i cellIndexFromLocal(const vec3f &localCoordinates) const;
+
+      //! The (inclusive) range of voxel indices interpolated inside a cell.
+      box3i cellVoxels(const vec3i &cellIndex) const;
+
+      //! The bounds of a cell in local (voxel space) coordinates.
+      box3f cellBounds(const vec3i &cellIndex) const;
+
+      float maxOpacity(const vec3i &cellIndex,
+                       const TransferFunction &tfn) const;
+
+      // Data //
+
+      //! Grid size in cells per dimension.
+      vec3i cellCount {0};
+
+      //! Size of the volume the grid was built for, in voxels.
+      vec3i volumeDimensions {0};
+
+      //! Voxel value range of each cell.
+      std::vector<vec2f> cellRange;
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline size_t GridAccelerator::numCells() const
+    {
+      return size_t(cellCount.x) * cellCount.y * cellCount.z;
+    }
+
+    inline vec3i GridAccelerator::cellIndex(size_t cellID) const
+    {
+      const int x = cellID % cellCount.x;
+      const int y = (cellID / cellCount.x) % cellCount.y;
+      const int z = cellID / (size_t(cellCount.x) * cellCount.y);
+      return {x, y, z};
+    }
+
+    inline size_t GridAccelerator::cellID(const vec3i &cellIndex) const
+    {
+      return cellIndex.x
+             + cellCount.x * (cellIndex.y + size_t(cellCount.y) * cellIndex.z);
+    }
+
+    inline vec3i
+    GridAccelerator::cellIndexFromLocal(const vec3f &localCoordinates) const
+    {
+      const vec3i index {int(localCoordinates.x) / CELL_WIDTH,
+                         int(localCoordinates.y) / CELL_WIDTH,
+                         int(localCoordinates.z) / CELL_WIDTH};
+      return clamp(index, vec3i{0}, cellCount - 1);
+    }
+
+    inline box3i GridAccelerator::cellVoxels(const vec3i &cellIndex) const
+    {
+      const vec3i lower = cellIndex * CELL_WIDTH;
+      const vec3i upper = min(lower + CELL_WIDTH, volumeDimensions - 1);
+      return {lower, upper};
+    }
+
+    inline box3f GridAccelerator::cellBounds(const vec3i &cellIndex) const
+    {
+      const box3i voxels = cellVoxels(cellIndex);
+      return {vec3f{voxels.lower}, vec3f{voxels.upper}};
+    }
+
+    inline float
+    GridAccelerator::maxOpacity(const vec3i &cellIndex,
+                                const TransferFunction &tfn) const
+    {
+      return tfn.maxOpacity(cellRange[cellID(cellIndex)]);
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
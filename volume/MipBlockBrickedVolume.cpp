@@ -0,0 +1,177 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+//ospray
+#include "MipBlockBrickedVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <cmath>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using MipBBV = MipBlockBrickedVolume;
+
+    // MipLevel definitions ///////////////////////////////////////////////////
+
+    void MipBBV::MipLevel::resize(const vec3i &levelDimensions)
+    {
+      dimensions = levelDimensions;
+      brickCount = (dimensions + 3) / 4;
+      voxels.resize(size_t(brickCount.x) * brickCount.y * brickCount.z * 64);
+    }
+
+    // MipBlockBrickedVolume definitions //////////////////////////////////////
+
+    std::string MipBBV::toString() const
+    {
+      return("ospray::cpp_renderer::MipBBV<" + voxelType + ">");
+    }
+
+    void MipBBV::commit()
+    {
+      BlockBrickedVolume::commit();
+
+      lodBias = getParam1f("lodBias", 0.f);
+
+      if (!pyramidValid) {
+        buildPyramid();
+        pyramidValid = true;
+      }
+    }
+
+    int MipBBV::setRegion(const void *source,
+                          const vec3i &index,
+                          const vec3i &count)
+    {
+      pyramidValid = false;
+      return BlockBrickedVolume::setRegion(source, index, count);
+    }
+
+    float MipBBV::computeSampleLOD(const vec3f &worldCoordinates,
+                                   float footprint) const
+    {
+      const int levelID = levelOfDetail(footprint);
+
+      if (levelID == 0)
+        return computeSample(worldCoordinates);
+
+      return sampleLevel(levelID, transformWorldToLocal(worldCoordinates));
+    }
+
+    int MipBBV::levelOfDetail(float footprint) const
+    {
+      // Footprint measured in voxels of the full resolution level.
+      const float footprintVoxels = footprint / samplingStep;
+
+      if (levels.empty() || footprintVoxels <= 1.f)
+        return 0;
+
+      const int levelID = int(std::log2(footprintVoxels) + lodBias);
+      return clamp(levelID, 0, int(levels.size()));
+    }
+
+    void MipBBV::buildPyramid()
+    {
+      levels.clear();
+
+      vec3i fineDimensions = dimensions;
+
+      // Halve the resolution while there are still voxels to interpolate.
+      while (reduce_min(fineDimensions) > 2) {
+        const MipLevel *fine = levels.empty() ? nullptr : &levels.back();
+
+        MipLevel level;
+        level.resize((fineDimensions + 1) / 2);
+
+        auto fineVoxel = [&](const vec3i &index) {
+          const vec3i clamped = min(index, fineDimensions - 1);
+          return fine ? fine->voxels[fine->address(clamped)]
+                      : getVoxel(clamped);
+        };
+
+        // Box filter the 2^3 finer voxels covered by each coarse voxel.
+        const vec3i dims = level.dimensions;
+        tasking::parallel_for(dims.z, [&](int z) {
+          for (int y = 0; y < dims.y; ++y) {
+            for (int x = 0; x < dims.x; ++x) {
+              const vec3i f = 2 * vec3i{x, y, z};
+
+              float sum = 0.f;
+              for (int i = 0; i < 8; ++i)
+                sum += fineVoxel(f + vec3i{i & 1, (i >> 1) & 1, i >> 2});
+
+              level.voxels[level.address(vec3i{x, y, z})] = 0.125f * sum;
+            }
+          }
+        });
+
+        fineDimensions = level.dimensions;
+        levels.push_back(std::move(level));
+      }
+    }
+
+    float MipBBV::sampleLevel(int levelID,
+                              const vec3f &localCoordinates) const
+    {
+      const auto &level = levels[levelID - 1];
+
+      // Voxel 'j' of level 'l' is centered at (j + 0.5) * 2^l - 0.5 in full
+      // resolution coordinates.
+      const float scale = 1.f / (1 << levelID);
+      const vec3f levelCoordinates =
+          clamp((localCoordinates + 0.5f) * scale - 0.5f,
+                vec3f{0.f}, vec3f{level.dimensions - 1});
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {levelCoordinates.x,
+                        levelCoordinates.y,
+                        levelCoordinates.z};
+      const vec3i vi_1 = min(vi_0 + 1, level.dimensions - 1);
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = levelCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      auto voxel = [&](int x, int y, int z) {
+        return level.voxels[level.address(vec3i{x, y, z})];
+      };
+
+      // "vv" means "voxelValue"
+      const float vv_000 = voxel(vi_0.x, vi_0.y, vi_0.z);
+      const float vv_001 = voxel(vi_1.x, vi_0.y, vi_0.z);
+      const float vv_010 = voxel(vi_0.x, vi_1.y, vi_0.z);
+      const float vv_011 = voxel(vi_1.x, vi_1.y, vi_0.z);
+      const float vv_100 = voxel(vi_0.x, vi_0.y, vi_1.z);
+      const float vv_101 = voxel(vi_1.x, vi_0.y, vi_1.z);
+      const float vv_110 = voxel(vi_0.x, vi_1.y, vi_1.z);
+      const float vv_111 = voxel(vi_1.x, vi_1.y, vi_1.z);
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    // A block bricked volume sampled from a resolution pyramid by footprint.
+    OSP_REGISTER_VOLUME(MipBlockBrickedVolume, cpp_mip_bbv);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
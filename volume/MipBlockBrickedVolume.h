@@ -0,0 +1,88 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "BlockBrickedVolume.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Block bricked volume with a pyramid of downsampled levels, built at
+        commit, from which samples are taken at the resolution matching the
+        footprint of the ray. */
+    class MipBlockBrickedVolume : public BlockBrickedVolume
+    {
+    public:
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      float computeSampleLOD(const vec3f &worldCoordinates,
+                             float footprint) const override;
+
+      int levelOfDetail(float footprint) const override;
+
+    private:
+
+      //! A downsampled level, stored in bricks of 4^3 voxels.
+      struct MipLevel
+      {
+        void resize(const vec3i &dimensions);
+
+        size_t address(const vec3i &index) const;
+
+        vec3i dimensions;
+        vec3i brickCount;
+        std::vector<float> voxels;
+      };
+
+      void buildPyramid();
+
+      //! Trilinearly interpolate level 'levelID' (> 0) at full resolution
+      //! local coordinates.
+      float sampleLevel(int levelID, const vec3f &localCoordinates) const;
+
+      // Data //
+
+      //! Levels 1..N, each half the resolution of the previous one.
+      std::vector<MipLevel> levels;
+
+      //! Offset added to the level chosen from the footprint.
+      float lodBias {0.f};
+
+      bool pyramidValid {false};
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline size_t
+    MipBlockBrickedVolume::MipLevel::address(const vec3i &index) const
+    {
+      const size_t brickID = (index.x >> 2) + brickCount.x *
+          ((index.y >> 2) + size_t(brickCount.y) * (index.z >> 2));
+
+      return (brickID << 6)
+             | ((index.z & 3) << 4) | ((index.y & 3) << 2) | (index.x & 3);
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
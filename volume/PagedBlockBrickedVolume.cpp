@@ -0,0 +1,330 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+//ospray
+#include "PagedBlockBrickedVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+
+//! The number of bits used to represent the width of a Block in voxels.
+#define BLOCK_VOXEL_WIDTH_BITCOUNT (6)
+
+//! The number of bits used to represent the width of a brick in voxels.
+#define BRICK_VOXEL_WIDTH_BITCOUNT (2)
+
+//! The number of bits used to represent the width of a block in bricks.
+#define BLOCK_BRICK_WIDTH_BITCOUNT (BLOCK_VOXEL_WIDTH_BITCOUNT - BRICK_VOXEL_WIDTH_BITCOUNT)
+
+//! The width of a block in voxels.
+#define BLOCK_VOXEL_WIDTH (1 << BLOCK_VOXEL_WIDTH_BITCOUNT)
+
+//! The width of a block in bricks.
+#define BLOCK_BRICK_WIDTH (1 << BLOCK_BRICK_WIDTH_BITCOUNT)
+
+//! The bits denoting the offset of a brick within a block.
+#define BLOCK_BRICK_BITMASK (BLOCK_BRICK_WIDTH - 1)
+
+//! The bits denoting the offset of a voxel within a brick.
+#define BRICK_VOXEL_BITMASK ((1 << BRICK_VOXEL_WIDTH_BITCOUNT) - 1)
+
+//! The number of voxels contained in a block.
+#define BLOCK_VOXEL_COUNT (BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH * BLOCK_VOXEL_WIDTH)
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using PagedBBV = PagedBlockBrickedVolume;
+
+    // PagedBlockBrickedVolume definitions ////////////////////////////////////
+
+    std::string PagedBBV::toString() const
+    {
+      return("ospray::cpp_renderer::PagedBBV<" + voxelType + ">");
+    }
+
+    void PagedBBV::commit()
+    {
+      if (!blockCache) constructVolumeMemory();
+      StructuredVolume::commit();
+
+      // Publish the cache counters accumulated up to this commit.
+      const BlockCache::Stats stats = blockCache->stats();
+      set("cacheHits", int(stats.hits));
+      set("cacheMisses", int(stats.misses));
+      set("cacheEvictions", int(stats.evictions));
+    }
+
+    int PagedBBV::setRegion(const void *source,
+                            const vec3i &regionCoords,
+                            const vec3i &regionSize)
+    {
+      if (!blockCache)
+        constructVolumeMemory();
+
+      // Copy voxel data into the volume, one run of voxels per task.
+      const size_t NTASKS = regionSize.y * regionSize.z;
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<uint8>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_SHORT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<int16>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_USHORT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<uint16>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_FLOAT:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<float>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      case OSP_DOUBLE:
+        tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+          setVoxelValues<double>(source, regionCoords, regionSize, taskIndex);
+        });
+        break;
+      default:
+        throw std::runtime_error("No voxel_t specificed in cpp paged bbv!");
+        break;
+      }
+
+      accumulateStatistics(voxel_t, source, regionCoords, regionSize);
+
+      return true;
+    }
+
+    float PagedBBV::computeSample(const vec3f &worldCoordinates) const
+    {
+      return (this->*sampleFcn)(worldCoordinates);
+    }
+
+    BlockCache::Stats PagedBBV::cacheStats() const
+    {
+      return blockCache ? blockCache->stats() : BlockCache::Stats{};
+    }
+
+    float PagedBBV::getVoxel(const vec3i &index) const
+    {
+      return (this->*voxelFcn)(index);
+    }
+
+    template <typename T>
+    float PagedBBV::computeSample_T(const vec3f &worldCoordinates) const
+    {
+      vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3f clampedLocalCoordinates = clamp(localCoordinates,
+                                                  vec3f{0.0f},
+                                                  localCoordinatesUpperBound);
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {clampedLocalCoordinates.x,
+                        clampedLocalCoordinates.y,
+                        clampedLocalCoordinates.z};
+      const vec3i vi_1 = vi_0 + 1;
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = clampedLocalCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      // "vv" means "voxelValue"
+      const float vv_000 = getVoxelValue<T>(vec3i{vi_0.x, vi_0.y, vi_0.z});
+      const float vv_001 = getVoxelValue<T>(vec3i{vi_1.x, vi_0.y, vi_0.z});
+      const float vv_010 = getVoxelValue<T>(vec3i{vi_0.x, vi_1.y, vi_0.z});
+      const float vv_011 = getVoxelValue<T>(vec3i{vi_1.x, vi_1.y, vi_0.z});
+      const float vv_100 = getVoxelValue<T>(vec3i{vi_0.x, vi_0.y, vi_1.z});
+      const float vv_101 = getVoxelValue<T>(vec3i{vi_1.x, vi_0.y, vi_1.z});
+      const float vv_110 = getVoxelValue<T>(vec3i{vi_0.x, vi_1.y, vi_1.z});
+      const float vv_111 = getVoxelValue<T>(vec3i{vi_1.x, vi_1.y, vi_1.z});
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    float PagedBBV::getVoxelValue(const vec3i &index) const
+    {
+      const Address address = getVoxelAddress(index);
+      return float(((const T*)getBlock(address.block))[address.voxel]);
+    }
+
+    template <typename T>
+    void PagedBBV::setVoxelValues(const void *source,
+                                  const vec3i &targetCoord000,
+                                  const vec3i &regionSize,
+                                  size_t taskIndex)
+    {
+      const uint32 region_y = taskIndex % regionSize.y;
+      const uint32 region_z = taskIndex / regionSize.y;
+      const uint64 runOfs = (uint64)regionSize.x *
+                            (region_y + (uint64)regionSize.y * region_z);
+      const T *run = (const T *)source + runOfs;
+      vec3i coord = targetCoord000 + vec3i{0, region_y, region_z};
+
+      if (coord.y < 0 || coord.z < 0 ||
+          coord.y >= dimensions.y || coord.z >= dimensions.z)
+        return;
+
+      // A run crosses only a few blocks, so keep the current one referenced
+      // instead of going through the cache for every voxel.
+      std::shared_ptr<byte_t> block;
+      uint64 blockID = 0;
+
+      for (int x = 0; x < regionSize.x; ++x) {
+        coord.x = targetCoord000.x + x;
+        if (coord.x < 0 || coord.x >= dimensions.x)
+          continue;
+
+        const Address address = getVoxelAddress(coord);
+
+        if (!block || address.block != blockID) {
+          blockID = address.block;
+          block   = blockCache->getForWriting(blockID);
+        }
+
+        ((T*)block.get())[address.voxel] = run[x];
+      }
+    }
+
+    size_t PagedBBV::brickID(const vec3f &worldCoordinates) const
+    {
+      const Address address = getVoxelAddress(voxelIndex(worldCoordinates));
+
+      // The voxel address holds the brick address above the voxel offset.
+      return (size_t(address.block) << (3 * BLOCK_BRICK_WIDTH_BITCOUNT))
+             | (address.voxel >> (3 * BRICK_VOXEL_WIDTH_BITCOUNT));
+    }
+
+    PagedBBV::Address PagedBBV::getVoxelAddress(const vec3i &index) const
+    {
+      Address address;
+
+      // Compute the 1D address of the block in the volume.
+      address.block = (index.x >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+        + blockCount.x * ((index.y >> BLOCK_VOXEL_WIDTH_BITCOUNT)
+                          + uint64(blockCount.y)
+                            * (index.z >> BLOCK_VOXEL_WIDTH_BITCOUNT));
+
+      // Compute the 1D address of the brick in the block.
+      const uint32 brickAddress
+        = ((index.x >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+        + (((index.y >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << BLOCK_BRICK_WIDTH_BITCOUNT)
+        + (((index.z >> BRICK_VOXEL_WIDTH_BITCOUNT) & BLOCK_BRICK_BITMASK)
+           << 2 * BLOCK_BRICK_WIDTH_BITCOUNT);
+
+      // Compute the 1D address of the voxel in the block.
+      address.voxel
+        = brickAddress << (3 * BRICK_VOXEL_WIDTH_BITCOUNT)
+        | (index.z & BRICK_VOXEL_BITMASK) << (2 * BRICK_VOXEL_WIDTH_BITCOUNT)
+        | (index.y & BRICK_VOXEL_BITMASK) << BRICK_VOXEL_WIDTH_BITCOUNT
+        | (index.x & BRICK_VOXEL_BITMASK);
+
+      return address;
+    }
+
+    const byte_t *PagedBBV::getBlock(uint64 blockID) const
+    {
+      struct BlockHandle
+      {
+        size_t cacheID {0};
+        uint64 blockID {0};
+        std::shared_ptr<const byte_t> data;
+      };
+
+      static thread_local BlockHandle last;
+
+      if (last.cacheID != blockCache->id() || last.blockID != blockID) {
+        last.data    = blockCache->get(blockID);
+        last.cacheID = blockCache->id();
+        last.blockID = blockID;
+      }
+
+      return last.data.get();
+    }
+
+    void PagedBBV::constructVolumeMemory()
+    {
+      // Get the voxel type.
+      voxelType = getParamString("voxelType", "unspecified");
+      voxel_t   = getVoxelType();
+      voxelSize = sizeOf(voxel_t);
+
+      // Get the volume dimensions.
+      this->dimensions = getParam3i("dimensions", vec3i(0));
+      exitOnCondition(reduce_min(this->dimensions) <= 0,
+                      "invalid volume dimensions (must be set before "
+                      "calling ospSetRegion())");
+
+      // Volume size in blocks per dimension with padding to the nearest block
+      blockCount = (dimensions + BLOCK_VOXEL_WIDTH - 1) / BLOCK_VOXEL_WIDTH;
+
+      const size_t numBlocks =
+          size_t(blockCount.x) * blockCount.y * blockCount.z;
+      const size_t blockSize = BLOCK_VOXEL_COUNT * voxelSize;
+
+      // Store file (a temporary file if not given) and memory budget in MB.
+      const std::string fileName = getParamString("blockFile", "");
+      const size_t cacheSizeMB   = getParam1i("cacheSizeMB", 2048);
+      const size_t capacity      = (cacheSizeMB << 20) / blockSize;
+
+      blockCache.reset(new BlockCache(fileName, blockSize,
+                                      numBlocks, capacity));
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        sampleFcn = &PagedBBV::computeSample_T<uint8>;
+        voxelFcn  = &PagedBBV::getVoxelValue<uint8>;
+        break;
+      case OSP_SHORT:
+        sampleFcn = &PagedBBV::computeSample_T<int16>;
+        voxelFcn  = &PagedBBV::getVoxelValue<int16>;
+        break;
+      case OSP_USHORT:
+        sampleFcn = &PagedBBV::computeSample_T<uint16>;
+        voxelFcn  = &PagedBBV::getVoxelValue<uint16>;
+        break;
+      case OSP_FLOAT:
+        sampleFcn = &PagedBBV::computeSample_T<float>;
+        voxelFcn  = &PagedBBV::getVoxelValue<float>;
+        break;
+      case OSP_DOUBLE:
+        sampleFcn = &PagedBBV::computeSample_T<double>;
+        voxelFcn  = &PagedBBV::getVoxelValue<double>;
+        break;
+      default:
+        throw std::runtime_error("No voxel_t specificed in cpp paged bbv!");
+        break;
+      }
+    }
+
+    // A block bricked volume paged from disk through an LRU block cache.
+    OSP_REGISTER_VOLUME(PagedBlockBrickedVolume, cpp_paged_bbv);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,112 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "StructuredVolume.h"
+#include "BlockCache.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Block bricked volume whose blocks live in a file-backed store and are
+        paged in through a bounded LRU cache, so volumes larger than memory
+        can be loaded and rendered. */
+    class PagedBlockBrickedVolume : public StructuredVolume
+    {
+    public:
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      //! The block and the brick within it holding the voxel at
+      //! 'worldCoordinates', in the order they are laid out in memory.
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+      //! Hit/miss/eviction counts of the block cache, also published as the
+      //! "cacheHits", "cacheMisses" and "cacheEvictions" parameters on commit.
+      BlockCache::Stats cacheStats() const;
+
+    private:
+
+      // Helper types //
+
+      struct Address
+      {
+        //! The 1D address of the block in the volume containing the voxel.
+        uint64 block;
+
+        //! The 1D offset of the voxel in the enclosing block.
+        uint32 voxel;
+      };
+
+      // StructuredVolume interface //
+
+      float getVoxel(const vec3i &index) const override;
+
+      // Helper functions //
+
+      template <typename T>
+      float computeSample_T(const vec3f &worldCoordinates) const;
+
+      template <typename T>
+      float getVoxelValue(const vec3i &index) const;
+
+      template <typename T>
+      void setVoxelValues(const void *source,
+                          const vec3i &targetCoord000,
+                          const vec3i &regionSize,
+                          size_t taskIndex);
+
+      Address getVoxelAddress(const vec3i &index) const;
+
+      //! Read access to a block, through a per-thread handle to the last
+      //! block used so repeated lookups bypass the cache lock.
+      const byte_t *getBlock(uint64 blockID) const;
+
+      void constructVolumeMemory();
+
+      // Data //
+
+      //! Volume size in blocks per dimension with padding to the nearest block.
+      vec3i blockCount;
+
+      //! Paged block storage.
+      std::unique_ptr<BlockCache> blockCache;
+
+      //! Voxel type.
+      OSPDataType voxel_t {OSP_UNKNOWN};
+
+      //! Voxel size in bytes.
+      size_t voxelSize;
+
+      using SampleFcn = float (PagedBlockBrickedVolume::*)(const vec3f &) const;
+      using VoxelFcn  = float (PagedBlockBrickedVolume::*)(const vec3i &) const;
+
+      //! Accessors for 'voxel_t', resolved once when the storage is created.
+      SampleFcn sampleFcn {nullptr};
+      VoxelFcn  voxelFcn  {nullptr};
+    };
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
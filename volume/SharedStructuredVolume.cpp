@@ -0,0 +1,271 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+//ospray
+#include "SharedStructuredVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using SSV = SharedStructuredVolume;
+
+    std::string SSV::toString() const
+    {
+      return("ospray::cpp_renderer::SharedStructuredVolume<" + voxelType + ">");
+    }
+
+    void SSV::commit()
+    {
+      resolveVoxelData();
+
+      // The application may have updated the shared array in place (or
+      // replaced it) since the last commit, so everything derived from the
+      // voxels is rebuilt from the array itself.
+      gradientCacheValid = false;
+      acceleratorValid   = false;
+
+      {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        statistics = VoxelStatistics{};
+        partialStatistics.clear();
+      }
+
+      collectStatistics(voxel_t, voxelData->data, vec3i(0), dimensions,
+                        getHistogramParams(voxel_t), partialStatistics);
+
+      StructuredVolume::commit();
+    }
+
+    void SSV::resolveVoxelData()
+    {
+      dimensions = getParam3i("dimensions", vec3i(0));
+      exitOnCondition(reduce_min(dimensions) <= 0, "invalid volume dimensions");
+
+      voxelData = getParamData("voxelData", nullptr);
+      exitOnCondition(voxelData.ptr == nullptr,
+                      "no voxelData specified for shared structured volume");
+
+      const size_t numVoxels =
+          size_t(dimensions.x) * dimensions.y * dimensions.z;
+      exitOnCondition(voxelData->numItems < numVoxels,
+                      "voxelData has fewer voxels than 'dimensions' requires");
+
+      // The array's own type wins over the "voxelType" parameter.
+      voxel_t   = voxelData->type;
+      voxelType = getParamString("voxelType", "unspecified");
+
+      switch (voxel_t) {
+      case OSP_UCHAR:
+        sampleFcn  = &SSV::computeSample_T<uint8>;
+        sampleFcnN = &SSV::computeSample_T<uint8>;
+        voxelFcn   = &SSV::getVoxel_T<uint8>;
+        break;
+      case OSP_SHORT:
+        sampleFcn  = &SSV::computeSample_T<int16>;
+        sampleFcnN = &SSV::computeSample_T<int16>;
+        voxelFcn   = &SSV::getVoxel_T<int16>;
+        break;
+      case OSP_USHORT:
+        sampleFcn  = &SSV::computeSample_T<uint16>;
+        sampleFcnN = &SSV::computeSample_T<uint16>;
+        voxelFcn   = &SSV::getVoxel_T<uint16>;
+        break;
+      case OSP_FLOAT:
+        sampleFcn  = &SSV::computeSample_T<float>;
+        sampleFcnN = &SSV::computeSample_T<float>;
+        voxelFcn   = &SSV::getVoxel_T<float>;
+        break;
+      case OSP_DOUBLE:
+        sampleFcn  = &SSV::computeSample_T<double>;
+        sampleFcnN = &SSV::computeSample_T<double>;
+        voxelFcn   = &SSV::getVoxel_T<double>;
+        break;
+      default:
+        throw std::runtime_error("unsupported voxelData type in cpp shared "
+                                 "structured volume!");
+        break;
+      }
+    }
+
+    int SSV::setRegion(const void *source,
+                       const vec3i &regionCoords,
+                       const vec3i &regionSize)
+    {
+      if (!voxelData)
+        resolveVoxelData();
+
+      const size_t voxelSize = sizeOf(voxel_t);
+      byte_t *target = (byte_t*)voxelData->data;
+
+      // Copy one clipped run of voxels per task.
+      const size_t NTASKS = regionSize.y * regionSize.z;
+
+      tasking::parallel_for(NTASKS, [&](size_t taskIndex) {
+        const int y = taskIndex % regionSize.y;
+        const int z = taskIndex / regionSize.y;
+
+        const vec3i coord = regionCoords + vec3i{0, y, z};
+
+        if (coord.y < 0 || coord.z < 0 ||
+            coord.y >= dimensions.y || coord.z >= dimensions.z)
+          return;
+
+        const int x0 = std::max(0, -coord.x);
+        const int x1 = std::min(regionSize.x, dimensions.x - coord.x);
+
+        if (x0 >= x1)
+          return;
+
+        const byte_t *run = (const byte_t*)source + voxelSize *
+            (x0 + regionSize.x * (y + uint64(regionSize.y) * z));
+
+        memcpy(target + voxelSize * getVoxelOffset(coord + vec3i{x0, 0, 0}),
+               run, voxelSize * (x1 - x0));
+      });
+
+      // The statistics, macrocells and gradients are rebuilt from the shared
+      // array on commit.
+      return true;
+    }
+
+    float SSV::computeSample(const vec3f &worldCoordinates) const
+    {
+      return (this->*sampleFcn)(worldCoordinates);
+    }
+
+    simd::vfloat SSV::computeSample(simd::vmaski active,
+                                    const simd::vec3f &worldCoordinates) const
+    {
+      return (this->*sampleFcnN)(active, worldCoordinates);
+    }
+
+    float SSV::getVoxel(const vec3i &index) const
+    {
+      return (this->*voxelFcn)(index);
+    }
+
+    template <typename T>
+    float SSV::getVoxel_T(const vec3i &index) const
+    {
+      return float(((const T*)voxelData->data)[getVoxelOffset(index)]);
+    }
+
+    template <typename T>
+    float SSV::computeSample_T(const vec3f &worldCoordinates) const
+    {
+      vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3f clampedLocalCoordinates = clamp(localCoordinates,
+                                                  vec3f{0.0f},
+                                                  localCoordinatesUpperBound);
+
+      // "vi" means "voxelIndex"
+      const vec3i vi_0 {clampedLocalCoordinates.x,
+                        clampedLocalCoordinates.y,
+                        clampedLocalCoordinates.z};
+
+      // "flc" means "fractionalLocalCoordinates"
+      const vec3f flc = clampedLocalCoordinates - vec3f{vi_0.x, vi_0.y, vi_0.z};
+
+      // Neighbors in the linear layout are at constant offsets.
+      const uint64 dy = dimensions.x;
+      const uint64 dz = uint64(dimensions.x) * dimensions.y;
+
+      const T *voxels = (const T*)voxelData->data + getVoxelOffset(vi_0);
+
+      // "vv" means "voxelValue"
+      const float vv_000 = float(voxels[0]);
+      const float vv_001 = float(voxels[1]);
+      const float vv_010 = float(voxels[dy]);
+      const float vv_011 = float(voxels[dy + 1]);
+      const float vv_100 = float(voxels[dz]);
+      const float vv_101 = float(voxels[dz + 1]);
+      const float vv_110 = float(voxels[dz + dy]);
+      const float vv_111 = float(voxels[dz + dy + 1]);
+
+      // Interpolate the voxel values.
+      const float vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const float vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const float vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const float vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const float vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const float vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    template <typename T>
+    simd::vfloat SSV::computeSample_T(simd::vmaski active,
+                                      const simd::vec3f &worldCoordinates) const
+    {
+      const simd::vec3f clampedLocalCoordinates =
+          clampLocal(transformWorldToLocal(worldCoordinates));
+
+      // "vi" means "voxelIndex"
+      const simd::vec3i vi_0 {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z)
+      };
+
+      // "flc" means "fractionalLocalCoordinates"
+      const simd::vec3f flc {
+        clampedLocalCoordinates.x - simd::cast<simd::vfloat>(vi_0.x),
+        clampedLocalCoordinates.y - simd::cast<simd::vfloat>(vi_0.y),
+        clampedLocalCoordinates.z - simd::cast<simd::vfloat>(vi_0.z)
+      };
+
+      const uint64 dy = dimensions.x;
+      const uint64 dz = uint64(dimensions.x) * dimensions.y;
+
+      // "vv" means "voxelValue"
+      simd::vfloat vv_000 {0.f}, vv_001 {0.f}, vv_010 {0.f}, vv_011 {0.f};
+      simd::vfloat vv_100 {0.f}, vv_101 {0.f}, vv_110 {0.f}, vv_111 {0.f};
+
+      // NOTE: linear offsets need 64-bit addressing, so gather per lane
+      simd::foreach_active(active, [&](int i) {
+        const T *voxels = (const T*)voxelData->data
+            + getVoxelOffset(vec3i{vi_0.x[i], vi_0.y[i], vi_0.z[i]});
+
+        vv_000[i] = float(voxels[0]);
+        vv_001[i] = float(voxels[1]);
+        vv_010[i] = float(voxels[dy]);
+        vv_011[i] = float(voxels[dy + 1]);
+        vv_100[i] = float(voxels[dz]);
+        vv_101[i] = float(voxels[dz + 1]);
+        vv_110[i] = float(voxels[dz + dy]);
+        vv_111[i] = float(voxels[dz + dy + 1]);
+      });
+
+      // Interpolate the voxel values.
+      const auto vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const auto vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const auto vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const auto vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const auto vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const auto vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    // A structured volume sampling the application's voxel array in place.
+    OSP_REGISTER_VOLUME(SharedStructuredVolume, cpp_shared_structured_volume);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,98 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "StructuredVolume.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Structured volume sampled directly from an application provided array
+        of voxels in x-fastest linear order ("voxelData"), without copying.
+        As the array may change in place, every commit recomputes the
+        statistics, macrocells and gradient cache from it. */
+    class SharedStructuredVolume : public StructuredVolume
+    {
+    public:
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      //! Copy voxels into the shared array.
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+
+    private:
+
+      // StructuredVolume interface //
+
+      float getVoxel(const vec3i &index) const override;
+
+      // Helper functions //
+
+      //! Get the voxel array and select the accessors for its type.
+      void resolveVoxelData();
+
+      template <typename T>
+      float computeSample_T(const vec3f &worldCoordinates) const;
+
+      template <typename T>
+      simd::vfloat computeSample_T(simd::vmaski active,
+                                   const simd::vec3f &worldCoordinates) const;
+
+      template <typename T>
+      float getVoxel_T(const vec3i &index) const;
+
+      uint64 getVoxelOffset(const vec3i &index) const;
+
+      // Data //
+
+      //! The application's voxel array.
+      Ref<Data> voxelData;
+
+      //! Voxel type.
+      OSPDataType voxel_t {OSP_UNKNOWN};
+
+      using SampleFcn  = float (SharedStructuredVolume::*)(const vec3f &) const;
+      using SampleFcnN = simd::vfloat (SharedStructuredVolume::*)(
+          simd::vmaski, const simd::vec3f &) const;
+      using VoxelFcn   = float (SharedStructuredVolume::*)(const vec3i &) const;
+
+      //! Accessors for 'voxel_t', resolved once in commit().
+      SampleFcn  sampleFcn  {nullptr};
+      SampleFcnN sampleFcnN {nullptr};
+      VoxelFcn   voxelFcn   {nullptr};
+    };
+
+    // Inlined definitions ////////////////////////////////////////////////////
+
+    inline uint64
+    SharedStructuredVolume::getVoxelOffset(const vec3i &index) const
+    {
+      return index.x + dimensions.x * (index.y + uint64(dimensions.y) * index.z);
+    }
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -16,10 +16,68 @@
 
 //ospray
 #include "StructuredVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <cmath>
 
 namespace ospray {
   namespace cpp_renderer {
 
+    // Helper functions ///////////////////////////////////////////////////////
+
+    //! Encoded value reserved for a zero gradient.
+    static constexpr uint32 FLAT_NORMAL = 0xFFFFFFFF;
+
+    /*! Octahedron encoding of a unit vector into two 16-bit coordinates (the
+        all-ones code is left free for FLAT_NORMAL). */
+    static inline uint32 encodeNormal(const vec3f &n)
+    {
+      const float l1 = ospcommon::abs(n.x) + ospcommon::abs(n.y)
+                       + ospcommon::abs(n.z);
+
+      if (!(l1 > 0.f))
+        return FLAT_NORMAL;
+
+      float u = n.x / l1;
+      float v = n.y / l1;
+
+      if (n.z < 0.f) {
+        const float fu = (1.f - ospcommon::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - ospcommon::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = fu;
+        v = fv;
+      }
+
+      auto quantize = [](float x) {
+        return uint32(clamp(int((0.5f * x + 0.5f) * 65535.f + 0.5f), 0, 65534));
+      };
+
+      return quantize(u) | (quantize(v) << 16);
+    }
+
+    static inline vec3f decodeNormal(uint32 code)
+    {
+      if (code == FLAT_NORMAL)
+        return vec3f(0.f);
+
+      const float u = float(code & 0xFFFF) * (2.f / 65535.f) - 1.f;
+      const float v = float(code >> 16)    * (2.f / 65535.f) - 1.f;
+
+      vec3f n {u, v, 1.f - ospcommon::abs(u) - ospcommon::abs(v)};
+
+      if (n.z < 0.f) {
+        const float fu = (1.f - ospcommon::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - ospcommon::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+        n.x = fu;
+        n.y = fv;
+      }
+
+      return normalize(n);
+    }
+
+    // StructuredVolume definitions ///////////////////////////////////////////
+
     std::string StructuredVolume::toString() const
     {
       return("ospray::cpp_renderer::StructuredVolume<" + voxelType + ">");
@@ -42,24 +100,78 @@ namespace ospray {
 #warning "localCoordinatesUpperBound should be checked! Subtract 1 or 2?"
       localCoordinatesUpperBound = vec3f{dimensions - 2};
 
-      if (!finished) {
-        voxelRange = getParam2f("voxelRange", voxelRange);
+      commitStatistics();
 
+      if (!getParam1i("gradientCache", 0))
+        gradientCache.clear();
+      else if (!gradientCacheValid || gradientCache.empty())
+        buildGradientCache();
+
+      if (!finished) {
         boundingBox = box3f{gridOrigin,
                             gridOrigin + vec3f{dimensions - 1} * gridSpacing};
 
         samplingStep = reduce_min(gridSpacing);
 
-        buildAccelerator();
         finished = true;
       }
+
+      // Regions loaded after the first commit change the cell ranges too.
+      if (!acceleratorValid) {
+        buildAccelerator();
+        acceleratorValid = true;
+      }
     }
 
     void StructuredVolume::computeSamples(float **results,
                                           const vec3f *worldCoordinates,
                                           const size_t &count)
     {
-      NOT_IMPLEMENTED
+      *results = (float*)malloc(count * sizeof(float));
+      exitOnCondition(*results == nullptr, "error allocating memory");
+
+      float *samples = *results;
+
+      // Points are split into chunks sampled in parallel; within a chunk they
+      // are visited in brick order, one SIMD packet at a time.
+      static constexpr size_t CHUNK_SIZE = 4096;
+      const size_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+      tasking::parallel_for(numChunks, [&](size_t chunkID) {
+        const size_t begin = chunkID * CHUNK_SIZE;
+        const size_t end   = std::min(begin + CHUNK_SIZE, count);
+
+        std::vector<std::pair<size_t, size_t>> order;
+        order.reserve(end - begin);
+
+        for (size_t i = begin; i < end; ++i)
+          order.emplace_back(brickID(worldCoordinates[i]), i);
+
+        std::sort(order.begin(), order.end());
+
+        simd::vint laneID;
+        for (int i = 0; i < simd::width; ++i)
+          laneID[i] = i;
+
+        for (size_t k = 0; k < order.size(); k += simd::width) {
+          const int numLanes = std::min(size_t(simd::width), order.size() - k);
+          const auto active  = laneID < simd::vint{numLanes};
+
+          simd::vec3f points {gridOrigin};
+
+          for (int i = 0; i < numLanes; ++i) {
+            const vec3f &p = worldCoordinates[order[k + i].second];
+            points.x[i] = p.x;
+            points.y[i] = p.y;
+            points.z[i] = p.z;
+          }
+
+          const simd::vfloat values = computeSample(active, points);
+
+          for (int i = 0; i < numLanes; ++i)
+            samples[order[k + i].second] = values[i];
+        }
+      });
     }
 
     float StructuredVolume::computeSample(const vec3f &worldCoordinates) const
@@ -108,34 +220,49 @@ namespace ospray {
       // Gradient step in each dimension (world coordinates).
       const vec3f &gradientStep = gridSpacing;
 
-      // The gradient will be computed using central differences.
-      vec3f gradient;
-
-      // Sample at gradient location.
-      float sample = computeSample(worldCoordinates);
-
       const auto step_x = vec3f{gradientStep.x, 0.0f, 0.0f};
       const auto step_y = vec3f{0.0f, gradientStep.y, 0.0f};
       const auto step_z = vec3f{0.0f, 0.0f, gradientStep.z};
 
-      // Gradient magnitude in the X direction.
-      gradient.x = computeSample(worldCoordinates + step_x) - sample;
+      // The gradient is computed using central differences.
+      vec3f gradient;
 
-      // Gradient magnitude in the Y direction.
-      gradient.y = computeSample(worldCoordinates + step_y) - sample;
+      gradient.x = computeSample(worldCoordinates + step_x)
+                   - computeSample(worldCoordinates - step_x);
+      gradient.y = computeSample(worldCoordinates + step_y)
+                   - computeSample(worldCoordinates - step_y);
+      gradient.z = computeSample(worldCoordinates + step_z)
+                   - computeSample(worldCoordinates - step_z);
 
-      // Gradient magnitude in the Z direction.
-      gradient.z = computeSample(worldCoordinates + step_z) - sample;
+      return gradient / (2.f * gradientStep);
+    }
 
-      // This approximation may yield image artifacts.
-      return gradient / gradientStep;
+    vec3f
+    StructuredVolume::computeShadingNormal(const vec3f &worldCoordinates) const
+    {
+      if (gradientCache.empty())
+        return Volume::computeShadingNormal(worldCoordinates);
+
+      // One fetch of the nearest voxel's quantized gradient.
+      const vec3f localCoordinates = transformWorldToLocal(worldCoordinates);
+
+      const vec3i index = clamp(vec3i{int(localCoordinates.x + 0.5f),
+                                      int(localCoordinates.y + 0.5f),
+                                      int(localCoordinates.z + 0.5f)},
+                                vec3i{0}, dimensions - 1);
+
+      return decodeNormal(gradientCache[index.x + size_t(dimensions.x)
+                                        * (index.y + size_t(dimensions.y)
+                                           * index.z)]);
     }
 
     bool StructuredVolume::intersect(Ray &ray) const
     {
       auto hits = intersectBox(ray, boundingBox);
 
-      if (hits.first < hits.second &&  hits.first < ray.t) {
+      // Clipping trims the interval once, rather than testing each sample.
+      if (hits.first < hits.second && hits.first < ray.t &&
+          clipInterval(ray.org, ray.dir, hits.first, hits.second)) {
         ray.t0 = hits.first;
         ray.t  = hits.second;
         return true;
@@ -144,29 +271,265 @@ namespace ospray {
       }
     }
 
-    void StructuredVolume::advance(Ray &ray) const
+    void StructuredVolume::advance(Ray &ray, float stepScale) const
     {
       // The recommended step size for ray casting based volume renderers.
-      const float step = samplingStep / samplingRate;
+      const float step = stepScale * samplingStep / samplingRate;
 
-#if 0
-      // Compute the next hit point using a spatial acceleration structure.
-      GridAccelerator_intersect(volume->accelerator, step, ray);
-#else
       ray.t0 += step;
-#endif
+      skipEmptySpace(ray, step);
     }
 
-    void StructuredVolume::advanceAdaptive(Ray &ray) const
+    bool StructuredVolume::advanceAdaptive(Ray &ray,
+                                           float &lastStep,
+                                           float sampleOpacity,
+                                           float stepScale) const
     {
-      NOT_IMPLEMENTED
+      // Sample more densely where the transfer function is more opaque, never
+      // dropping below the base sampling rate.
+      const float maxRate  = ospcommon::max(samplingRate,
+                                            adaptiveMaxSamplingRate);
+      const float rate     = clamp(adaptiveScalar * sampleOpacity,
+                                   samplingRate, maxRate);
+      const float step     = stepScale * samplingStep / rate;
+
+      // The last (much larger) step may have jumped into an opaque feature: go
+      // back and retake it with the finer step size.
+      if (sampleOpacity > adaptiveBacktrack && lastStep > 1.25f * step) {
+        ray.t0  += step - lastStep;
+        lastStep = step;
+        return false;
+      }
+
+      ray.t0  += step;
+      lastStep = step;
+
+      const float t0 = ray.t0;
+      skipEmptySpace(ray, step);
+
+      // Empty space was skipped, so the next sample is reached by a large step
+      // through transparent cells which never needs to be backtracked.
+      if (ray.t0 != t0)
+        lastStep = 0.f;
+
+      return true;
     }
 
     void
     StructuredVolume::intersectIsosurface(const std::vector<float> &isovalues,
                                           Ray &ray) const
     {
-      NOT_IMPLEMENTED
+      if (isovalues.empty())
+        return;
+
+      // Only the (clipped) interval found by intersect() is searched.
+      const float tBegin = ray.t0;
+      const float tEnd   = ray.t;
+
+      if (!(tBegin < tEnd))
+        return;
+
+      const float step = samplingStep / samplingRate;
+
+      auto valueAt = [&](float t) {
+        return computeSample(ray.org + t * ray.dir);
+      };
+
+      // The last sample taken, if the samples are still contiguous.
+      bool  havePrevious = false;
+      float t0 = tBegin;
+      float v0 = 0.f;
+
+      float t = tBegin;
+
+      while (t < tEnd) {
+        const vec3f localCoordinates =
+            transformWorldToLocal(ray.org + t * ray.dir);
+        const vec3i cell  = accelerator.cellIndexFromLocal(localCoordinates);
+        const vec2f range = accelerator.cellRange[accelerator.cellID(cell)];
+
+        const box3f localBounds = accelerator.cellBounds(cell);
+        const box3f cellBounds {transformLocalToWorld(localBounds.lower),
+                                transformLocalToWorld(localBounds.upper)};
+
+        const float tExit =
+            ospcommon::min(intersectBox(ray, cellBounds).second, tEnd);
+
+        const bool mayContainIsovalue =
+            std::any_of(isovalues.begin(), isovalues.end(), [&](float iso) {
+              return iso >= range.x && iso <= range.y;
+            });
+
+        if (!mayContainIsovalue) {
+          havePrevious = false;
+          t = ospcommon::max(tExit, t) + 1e-3f * step;
+          continue;
+        }
+
+        if (!havePrevious) {
+          t0 = t;
+          v0 = valueAt(t0);
+          havePrevious = true;
+        }
+
+        // March through the cell looking for a crossing between two samples.
+        do {
+          const float t1 = ospcommon::min(t0 + step, tEnd);
+          const float v1 = valueAt(t1);
+
+          float tHit  = inf;
+          int   isoID = -1;
+
+          for (size_t i = 0; i < isovalues.size(); ++i) {
+            const float iso = isovalues[i];
+            if ((v0 < iso) != (v1 < iso)) {
+              const float tIso = refineIsosurfaceHit(ray, iso, t0, v0, t1, v1);
+              if (tIso < tHit) {
+                tHit  = tIso;
+                isoID = i;
+              }
+            }
+          }
+
+          if (isoID >= 0) {
+            ray.t      = tHit;
+            ray.primID = isoID;
+            ray.Ng     = computeGradient(ray.org + tHit * ray.dir);
+            return;
+          }
+
+          if (t1 >= tEnd)
+            return;
+
+          t0 = t1;
+          v0 = v1;
+        } while (t0 < tExit);
+
+        t = t0;
+      }
+    }
+
+    size_t StructuredVolume::brickID(const vec3f &worldCoordinates) const
+    {
+      // Fallback for volumes without a bricked memory layout: bricks of 4^3
+      // voxels grouped into blocks of 64^3 voxels, a spatially coherent key.
+      // Bricked volumes override this with the key of their own layout.
+      const vec3i voxel = voxelIndex(worldCoordinates);
+      const vec3i block {voxel.x / 64, voxel.y / 64, voxel.z / 64};
+      const vec3i brick {(voxel.x / 4) % 16,
+                         (voxel.y / 4) % 16,
+                         (voxel.z / 4) % 16};
+
+      const vec3i blockCount = (dimensions + 63) / 64;
+
+      const size_t blockID =
+          block.x + blockCount.x * (block.y + size_t(blockCount.y) * block.z);
+
+      return (blockID << 12) | (brick.z << 8) | (brick.y << 4) | brick.x;
+    }
+
+    simd::vfloat
+    StructuredVolume::computeSample(simd::vmaski active,
+                                    const simd::vec3f &worldCoordinates) const
+    {
+      const simd::vec3f clampedLocalCoordinates =
+          clampLocal(transformWorldToLocal(worldCoordinates));
+
+      // Lower and upper corners of the box straddling the voxels to be
+      // interpolated. "vi" means "voxelIndex"
+      const simd::vec3i vi_0 {
+        simd::cast<simd::vint>(clampedLocalCoordinates.x),
+        simd::cast<simd::vint>(clampedLocalCoordinates.y),
+        simd::cast<simd::vint>(clampedLocalCoordinates.z)
+      };
+      const simd::vec3i vi_1 {vi_0.x + 1, vi_0.y + 1, vi_0.z + 1};
+
+      // Fractional coordinates within the lower corner voxel used during
+      // interpolation. "flc" means "fractionalLocalCoordinates"
+      const simd::vec3f flc {
+        clampedLocalCoordinates.x - simd::cast<simd::vfloat>(vi_0.x),
+        clampedLocalCoordinates.y - simd::cast<simd::vfloat>(vi_0.y),
+        clampedLocalCoordinates.z - simd::cast<simd::vfloat>(vi_0.z)
+      };
+
+      // Look up the voxel values to be interpolated. "vv" means "voxelValue"
+      auto vv_000 = getVoxel(active, simd::vec3i{vi_0.x, vi_0.y, vi_0.z});
+      auto vv_001 = getVoxel(active, simd::vec3i{vi_1.x, vi_0.y, vi_0.z});
+      auto vv_010 = getVoxel(active, simd::vec3i{vi_0.x, vi_1.y, vi_0.z});
+      auto vv_011 = getVoxel(active, simd::vec3i{vi_1.x, vi_1.y, vi_0.z});
+      auto vv_100 = getVoxel(active, simd::vec3i{vi_0.x, vi_0.y, vi_1.z});
+      auto vv_101 = getVoxel(active, simd::vec3i{vi_1.x, vi_0.y, vi_1.z});
+      auto vv_110 = getVoxel(active, simd::vec3i{vi_0.x, vi_1.y, vi_1.z});
+      auto vv_111 = getVoxel(active, simd::vec3i{vi_1.x, vi_1.y, vi_1.z});
+
+      // Interpolate the voxel values.
+      const auto vv_00 = vv_000 + flc.x * (vv_001 - vv_000);
+      const auto vv_01 = vv_010 + flc.x * (vv_011 - vv_010);
+      const auto vv_10 = vv_100 + flc.x * (vv_101 - vv_100);
+      const auto vv_11 = vv_110 + flc.x * (vv_111 - vv_110);
+      const auto vv_0  = vv_00  + flc.y * (vv_01  - vv_00 );
+      const auto vv_1  = vv_10  + flc.y * (vv_11  - vv_10 );
+
+      return vv_0 + flc.z * (vv_1 - vv_0);
+    }
+
+    simd::vmaski StructuredVolume::intersect(simd::vmaski active,
+                                             RayN &ray) const
+    {
+      auto hits = intersectBox(ray, boundingBox);
+
+      auto hit = active & (hits.first < hits.second) & (hits.first < ray.t);
+      hit = clipInterval(hit, ray.org, ray.dir, hits.first, hits.second);
+
+      ray.t0 = simd::select(hit, hits.first, ray.t0);
+      ray.t  = simd::select(hit, hits.second, ray.t);
+
+      return hit;
+    }
+
+    void StructuredVolume::advance(simd::vmaski active, RayN &ray) const
+    {
+      const float step = samplingStep / samplingRate;
+
+      ray.t0 = simd::select(active, ray.t0 + step, ray.t0);
+      skipEmptySpace(active, ray, simd::vfloat{step});
+    }
+
+    simd::vmaski
+    StructuredVolume::advanceAdaptive(simd::vmaski active,
+                                      RayN &ray,
+                                      simd::vfloat &lastStep,
+                                      const simd::vfloat &sampleOpacity) const
+    {
+      const float maxRate = ospcommon::max(samplingRate,
+                                           adaptiveMaxSamplingRate);
+
+      simd::vfloat rate = adaptiveScalar * sampleOpacity;
+      rate = simd::select(rate > samplingRate, rate, samplingRate);
+      rate = simd::select(rate < maxRate, rate, maxRate);
+
+      const simd::vfloat step = samplingStep / rate;
+
+      const auto backtrack = active
+                             & (sampleOpacity > adaptiveBacktrack)
+                             & (lastStep > 1.25f * step);
+      const auto accepted  = active & !backtrack;
+
+      ray.t0 = simd::select(backtrack, ray.t0 + step - lastStep,
+                            simd::select(accepted, ray.t0 + step, ray.t0));
+      lastStep = simd::select(active, step, lastStep);
+
+      const simd::vfloat t0 = ray.t0;
+      skipEmptySpace(accepted, ray, step);
+      lastStep = simd::select(ray.t0 != t0, 0.f, lastStep);
+
+      return accepted;
+    }
+
+    vec3i StructuredVolume::voxelIndex(const vec3f &worldCoordinates) const
+    {
+      return vec3i(clamp(transformWorldToLocal(worldCoordinates),
+                         vec3f{0.f}, localCoordinatesUpperBound));
     }
 
     vec3f
@@ -181,6 +544,76 @@ namespace ospray {
       return rcp(gridSpacing) * (worldCoords - gridOrigin);
     }
 
+    simd::vec3f
+    StructuredVolume::transformWorldToLocal(const simd::vec3f &worldCoords) const
+    {
+      return simd::vec3f{rcp(gridSpacing)}
+             * (worldCoords - simd::vec3f{gridOrigin});
+    }
+
+    simd::vec3f
+    StructuredVolume::clampLocal(const simd::vec3f &localCoords) const
+    {
+      auto clampf = [](const simd::vfloat &v, float upper) {
+        const auto lower = simd::select(v > 0.f, v, 0.f);
+        return simd::select(lower < upper, lower, upper);
+      };
+
+      return {clampf(localCoords.x, localCoordinatesUpperBound.x),
+              clampf(localCoords.y, localCoordinatesUpperBound.y),
+              clampf(localCoords.z, localCoordinatesUpperBound.z)};
+    }
+
+    simd::vfloat StructuredVolume::getVoxel(simd::vmaski active,
+                                            const simd::vec3i &index) const
+    {
+      simd::vfloat result {0.f};
+
+      simd::foreach_active(active, [&](int i) {
+        result[i] = getVoxel(vec3i{index.x[i], index.y[i], index.z[i]});
+      });
+
+      return result;
+    }
+
+    void StructuredVolume::skipEmptySpace(Ray &ray, float step) const
+    {
+      const auto &tfn = *transferFunction;
+
+      while (ray.t0 < ray.t) {
+        const vec3f localCoordinates =
+            transformWorldToLocal(ray.org + ray.t0 * ray.dir);
+        const vec3i cell = accelerator.cellIndexFromLocal(localCoordinates);
+
+        if (accelerator.maxOpacity(cell, tfn) > 0.f)
+          return;
+
+        const box3f localBounds = accelerator.cellBounds(cell);
+        const box3f cellBounds {transformLocalToWorld(localBounds.lower),
+                                transformLocalToWorld(localBounds.upper)};
+
+        const float tExit = intersectBox(ray, cellBounds).second;
+        ray.t0 += ospcommon::max(1.f, ceilf((tExit - ray.t0) / step)) * step;
+      }
+    }
+
+    void StructuredVolume::skipEmptySpace(simd::vmaski active,
+                                          RayN &ray,
+                                          const simd::vfloat &step) const
+    {
+      simd::foreach_active(active, [&](int i) {
+        Ray lane;
+        lane.org = vec3f{ray.org.x[i], ray.org.y[i], ray.org.z[i]};
+        lane.dir = vec3f{ray.dir.x[i], ray.dir.y[i], ray.dir.z[i]};
+        lane.t0  = ray.t0[i];
+        lane.t   = ray.t[i];
+
+        skipEmptySpace(lane, step[i]);
+
+        ray.t0[i] = lane.t0;
+      });
+    }
+
     bool StructuredVolume::scaleRegion(const void *source, void *&out,
                                        vec3i &regionSize, vec3i &regionCoords)
     {
@@ -234,21 +667,256 @@ namespace ospray {
 
     void StructuredVolume::buildAccelerator()
     {
-#if 0
-      // Create instance of volume accelerator.
-      void *accel = ispc::StructuredVolume_createAccelerator(ispcEquivalent);
-
-      vec3i brickCount;
-      brickCount.x = ispc::GridAccelerator_getBrickCount_x(accel);
-      brickCount.y = ispc::GridAccelerator_getBrickCount_y(accel);
-      brickCount.z = ispc::GridAccelerator_getBrickCount_z(accel);
-
-      // Build volume accelerator.
-      const int NTASKS = brickCount.x * brickCount.y * brickCount.z;
-      parallel_for(NTASKS, [&](int taskIndex){
-        ispc::GridAccelerator_buildAccelerator(ispcEquivalent, taskIndex);
+      accelerator.resize(dimensions);
+
+      // Build the value range of each cell in parallel.
+      tasking::parallel_for(accelerator.numCells(), [&](size_t cellID) {
+        const box3i voxels =
+            accelerator.cellVoxels(accelerator.cellIndex(cellID));
+
+        vec2f range {FLT_MAX, -FLT_MAX};
+
+        for (int z = voxels.lower.z; z <= voxels.upper.z; ++z) {
+          for (int y = voxels.lower.y; y <= voxels.upper.y; ++y) {
+            for (int x = voxels.lower.x; x <= voxels.upper.x; ++x) {
+              const float value = getVoxel(vec3i{x, y, z});
+              range.x = ospcommon::min(range.x, value);
+              range.y = ospcommon::max(range.y, value);
+            }
+          }
+        }
+
+        accelerator.cellRange[cellID] = range;
       });
-#endif
+    }
+
+    void StructuredVolume::accumulateStatistics(OSPDataType type,
+                                                const void *source,
+                                                const vec3i &regionCoords,
+                                                const vec3i &regionSize)
+    {
+      // The loaded voxels also invalidate the cached gradients and the
+      // macrocell value ranges.
+      gradientCacheValid = false;
+      acceleratorValid   = false;
+
+      collectStatistics(type, source, regionCoords, regionSize,
+                        getHistogramParams(type), partialStatistics);
+    }
+
+    StructuredVolume::HistogramParams
+    StructuredVolume::getHistogramParams(OSPDataType type)
+    {
+      // Integer voxels are binned over their type's range by default, floating
+      // point voxels only once a range is known up front.
+      vec2f defaultRange = getParam2f("voxelRange", vec2f(0.f, -1.f));
+
+      switch (type) {
+      case OSP_UCHAR:
+        defaultRange = vec2f(0.f, 255.f);
+        break;
+      case OSP_SHORT:
+        defaultRange = vec2f(-32768.f, 32767.f);
+        break;
+      case OSP_USHORT:
+        defaultRange = vec2f(0.f, 65535.f);
+        break;
+      default:
+        break;
+      }
+
+      HistogramParams params;
+      params.range = getParam2f("histogramRange", defaultRange);
+      params.bins  = params.range.x < params.range.y ?
+          std::max(getParam1i("histogramBins", 0), 0) : 0;
+      return params;
+    }
+
+    void StructuredVolume::collectStatistics(
+        OSPDataType type,
+        const void *source,
+        const vec3i &regionCoords,
+        const vec3i &regionSize,
+        const HistogramParams &histogram,
+        std::vector<VoxelStatistics> &partials)
+    {
+      switch (type) {
+      case OSP_UCHAR:
+        accumulateStatistics_T((const uint8*)source, regionCoords, regionSize,
+                               histogram, partials);
+        break;
+      case OSP_SHORT:
+        accumulateStatistics_T((const int16*)source, regionCoords, regionSize,
+                               histogram, partials);
+        break;
+      case OSP_USHORT:
+        accumulateStatistics_T((const uint16*)source, regionCoords, regionSize,
+                               histogram, partials);
+        break;
+      case OSP_FLOAT:
+        accumulateStatistics_T((const float*)source, regionCoords, regionSize,
+                               histogram, partials);
+        break;
+      case OSP_DOUBLE:
+        accumulateStatistics_T((const double*)source, regionCoords, regionSize,
+                               histogram, partials);
+        break;
+      default:
+        break;
+      }
+    }
+
+    template <typename T>
+    void StructuredVolume::accumulateStatistics_T(const T *source,
+                                                  const vec3i &regionCoords,
+                                                  const vec3i &regionSize,
+                                                  const HistogramParams
+                                                    &histogram,
+                                                  std::vector<VoxelStatistics>
+                                                    &partials)
+    {
+      // The part of the region inside of the volume, relative to the region.
+      const vec3i lower = max(regionCoords, vec3i(0)) - regionCoords;
+      const vec3i upper = min(regionCoords + regionSize, dimensions)
+                          - regionCoords;
+
+      if (reduce_min(upper - lower) <= 0)
+        return;
+
+      const vec2f histogramRange = histogram.range;
+      const int bins = histogram.bins;
+      const float binScale = bins / (histogramRange.y - histogramRange.x);
+
+      // Each task reduces a slab of slices into its own partial result.
+      static constexpr int SLAB_SLICES = 8;
+      const int numSlabs = (upper.z - lower.z + SLAB_SLICES - 1) / SLAB_SLICES;
+
+      tasking::parallel_for(numSlabs, [&](int slabID) {
+        const int z0 = lower.z + slabID * SLAB_SLICES;
+        const int z1 = std::min(z0 + SLAB_SLICES, upper.z);
+
+        // Non-finite voxels are left out, the renderers treat NaN as
+        // transparent.
+        float minValue =  FLT_MAX;
+        float maxValue = -FLT_MAX;
+
+        VoxelStatistics partial;
+        partial.histogram.assign(bins, 0);
+
+        for (int z = z0; z < z1; ++z) {
+          for (int y = lower.y; y < upper.y; ++y) {
+            const T *run = source + lower.x
+              + regionSize.x * (y + uint64(regionSize.y) * z);
+            const int count = upper.x - lower.x;
+
+            for (int x = 0; x < count; ++x) {
+              const float value = float(run[x]);
+              if (std::isfinite(value)) {
+                minValue = std::min(minValue, value);
+                maxValue = std::max(maxValue, value);
+              }
+            }
+
+            if (bins == 0)
+              continue;
+
+            for (int x = 0; x < count; ++x) {
+              const float value = float(run[x]);
+              if (!std::isfinite(value))
+                continue;
+
+              // Clamp before converting, far out of range values overflow int.
+              const float bin = (value - histogramRange.x) * binScale;
+              partial.histogram[int(clamp(bin, 0.f, bins - 1.f))]++;
+            }
+          }
+        }
+
+        partial.range = vec2f(minValue, maxValue);
+
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        partials.push_back(std::move(partial));
+      });
+    }
+
+    void StructuredVolume::commitStatistics()
+    {
+      {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+
+        for (const auto &partial : partialStatistics) {
+          statistics.range.x = std::min(statistics.range.x, partial.range.x);
+          statistics.range.y = std::max(statistics.range.y, partial.range.y);
+
+          // The binning only changes if "histogramBins" changed between loads,
+          // in which case the newest one wins.
+          if (statistics.histogram.size() != partial.histogram.size())
+            statistics.histogram.assign(partial.histogram.size(), 0);
+
+          for (size_t i = 0; i < partial.histogram.size(); ++i)
+            statistics.histogram[i] += partial.histogram[i];
+        }
+
+        partialStatistics.clear();
+      }
+
+      const bool computed = statistics.range.x <= statistics.range.y;
+
+      // A "voxelRange" set by the user wins on every commit, the parameter
+      // only belongs to the volume while it still holds the published range.
+      const bool userRange = findParam("voxelRange") &&
+          (!voxelRangeComputed ||
+           getParam2f("voxelRange", voxelRange) != voxelRange);
+
+      if (userRange) {
+        voxelRange = getParam2f("voxelRange", voxelRange);
+        voxelRangeComputed = false;
+      } else if (computed) {
+        voxelRange = statistics.range;
+        voxelRangeComputed = true;
+        set("voxelRange", voxelRange);
+      }
+
+      // Counts are published as 64-bit integers, so they stay exact.
+      if (!statistics.histogram.empty()) {
+        histogramData = new Data(statistics.histogram.size(), OSP_ULONG,
+                                 statistics.histogram.data());
+        set("histogram", (ManagedObject*)histogramData.ptr);
+      }
+    }
+
+    void StructuredVolume::buildGradientCache()
+    {
+      gradientCache.resize(size_t(dimensions.x) * dimensions.y * dimensions.z);
+
+      tasking::parallel_for(dimensions.z, [&](int z) {
+        for (int y = 0; y < dimensions.y; ++y) {
+          for (int x = 0; x < dimensions.x; ++x) {
+            const vec3i index {x, y, z};
+
+            // Central differences, one-sided at the boundary.
+            const vec3i lo = max(index - 1, vec3i{0});
+            const vec3i hi = min(index + 1, dimensions - 1);
+
+            const vec3f gradient {
+              (getVoxel(vec3i{hi.x, y, z}) - getVoxel(vec3i{lo.x, y, z}))
+                / (max(hi.x - lo.x, 1) * gridSpacing.x),
+              (getVoxel(vec3i{x, hi.y, z}) - getVoxel(vec3i{x, lo.y, z}))
+                / (max(hi.y - lo.y, 1) * gridSpacing.y),
+              (getVoxel(vec3i{x, y, hi.z}) - getVoxel(vec3i{x, y, lo.z}))
+                / (max(hi.z - lo.z, 1) * gridSpacing.z)
+            };
+
+            const float len = length(gradient);
+
+            gradientCache[x + size_t(dimensions.x) * (y + size_t(dimensions.y)
+                                                      * z)] =
+                len > 0.f ? encodeNormal(gradient / len) : FLAT_NORMAL;
+          }
+        }
+      });
+
+      gradientCacheValid = true;
     }
 
     OSPDataType StructuredVolume::getVoxelType()
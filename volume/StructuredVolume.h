@@ -21,7 +21,11 @@
 #include "ospcommon/tasking/parallel_for.h"
 #endif
 
+#include "common/Data.h"
 #include "Volume.h"
+#include "GridAccelerator.h"
+// std
+#include <mutex>
 
 namespace ospray {
   namespace cpp_renderer {
@@ -51,25 +55,87 @@ namespace ospray {
 
       vec3f computeGradient(const vec3f &worldCoordinates) const override;
 
+      vec3f computeShadingNormal(const vec3f &worldCoordinates) const override;
+
       bool intersect(Ray &ray) const override;
 
-      void advance(Ray &ray) const override;
-      void advanceAdaptive(Ray &ray) const override;
+      void advance(Ray &ray, float stepScale) const override;
+      bool advanceAdaptive(Ray &ray,
+                           float &lastStep,
+                           float sampleOpacity,
+                           float stepScale) const override;
 
       void intersectIsosurface(const std::vector<float> &isovalues,
                                Ray &ray) const override;
 
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+
+      simd::vmaski intersect(simd::vmaski active, RayN &ray) const override;
+
+      void advance(simd::vmaski active, RayN &ray) const override;
+
+      simd::vmaski advanceAdaptive(simd::vmaski active,
+                                   RayN &ray,
+                                   simd::vfloat &lastStep,
+                                   const simd::vfloat &sampleOpacity)
+                                   const override;
+
     protected:
 
+      // Helper types //
+
+      struct VoxelStatistics
+      {
+        //! Value range of the voxels seen.
+        vec2f range {FLT_MAX, -FLT_MAX};
+
+        //! Voxel count per bin, bins evenly dividing 'histogramRange'.
+        std::vector<uint64> histogram;
+      };
+
+      struct HistogramParams
+      {
+        //! Number of bins, 0 if no histogram is computed.
+        int bins {0};
+
+        //! Value range evenly divided by the bins.
+        vec2f range {0.f, -1.f};
+      };
+
       // Internal interface //
 
       virtual float getVoxel(const vec3i &index) const = 0;
 
+      //! Fetch voxels for the active lanes; defaults to per-lane getVoxel().
+      virtual simd::vfloat getVoxel(simd::vmaski active,
+                                    const simd::vec3i &index) const;
+
       // Interal methods //
 
       vec3f transformLocalToWorld(const vec3f &localCoords) const;
       vec3f transformWorldToLocal(const vec3f &worldCoords) const;
 
+      simd::vec3f transformWorldToLocal(const simd::vec3f &worldCoords) const;
+
+      //! Index of the voxel containing 'worldCoordinates', clamped to the
+      //! volume.
+      vec3i voxelIndex(const vec3f &worldCoordinates) const;
+
+      //! Clamp local coordinates to the interpolatable interior of the volume.
+      simd::vec3f clampLocal(const simd::vec3f &localCoords) const;
+
+      //! Move 'ray.t0' past cells with zero opacity, in multiples of 'step'.
+      void skipEmptySpace(Ray &ray, float step) const;
+
+      //! Per-lane skipEmptySpace() for the active lanes of a packet.
+      void skipEmptySpace(simd::vmaski active,
+                          RayN &ray,
+                          const simd::vfloat &step) const;
+
 #if 0
       template<typename T>
       void upsampleRegion(const T *source,
@@ -81,6 +147,44 @@ namespace ospray {
       bool scaleRegion(const void *source, void *&out,
                        vec3i &regionSize, vec3i &regionCoords);
 
+      //! Accumulate the value range (and histogram, if "histogramBins" is set)
+      //! of the part of a region landing inside of the volume. Partial results
+      //! are merged and published as parameters in commit().
+      void accumulateStatistics(OSPDataType type,
+                                const void *source,
+                                const vec3i &regionCoords,
+                                const vec3i &regionSize);
+
+      //! "histogramBins" and "histogramRange" (defaulting to the range of
+      //! integer voxel types, else to "voxelRange"); read on the commit
+      //! thread so background loaders never touch the parameters.
+      HistogramParams getHistogramParams(OSPDataType type);
+
+      //! Append the statistics of a region to 'partials' (which is guarded by
+      //! 'statisticsMutex'), without invalidating any derived data or reading
+      //! any parameters.
+      void collectStatistics(OSPDataType type,
+                             const void *source,
+                             const vec3i &regionCoords,
+                             const vec3i &regionSize,
+                             const HistogramParams &histogram,
+                             std::vector<VoxelStatistics> &partials);
+
+      template <typename T>
+      void accumulateStatistics_T(const T *source,
+                                  const vec3i &regionCoords,
+                                  const vec3i &regionSize,
+                                  const HistogramParams &histogram,
+                                  std::vector<VoxelStatistics> &partials);
+
+      //! Merge the partial statistics and publish "voxelRange" (unless set by
+      //! the user) and "histogram" (OSP_ULONG counts).
+      void commitStatistics();
+
+      //! Quantize the (central difference) gradient direction of every voxel
+      //! into 'gradientCache'.
+      void buildGradientCache();
+
       //! build the accelerator - allows child class (data distributed) to avoid
       //! building..
       virtual void buildAccelerator();
@@ -90,7 +194,8 @@ namespace ospray {
 
       // Data //
 
-      // TODO: ptr|ref to GridAccelerator
+      //! Macrocell grid used to skip fully transparent regions while marching.
+      GridAccelerator accelerator;
 
       //! Volume size in voxels per dimension.
       vec3i dimensions;
@@ -107,6 +212,32 @@ namespace ospray {
       //! Voxel value range (will be computed if not provided as a parameter).
       vec2f voxelRange {FLT_MAX, -FLT_MAX};
 
+      //! Statistics merged from all regions loaded so far.
+      VoxelStatistics statistics;
+
+      //! Statistics of the tasks which loaded regions since the last commit.
+      std::vector<VoxelStatistics> partialStatistics;
+
+      std::mutex statisticsMutex;
+
+      //! Whether "voxelRange" holds the computed range published by the last
+      //! commit (rather than the user's).
+      bool voxelRangeComputed {false};
+
+      //! The histogram published as the "histogram" parameter.
+      Ref<Data> histogramData;
+
+      //! Per-voxel gradient directions, octahedron encoded in 2x16 bits
+      //! (empty unless "gradientCache" is enabled).
+      std::vector<uint32> gradientCache;
+
+      //! Whether 'gradientCache' matches the voxels currently loaded.
+      bool gradientCacheValid {false};
+
+      //! Whether the macrocell ranges of 'accelerator' match the voxels
+      //! currently loaded.
+      bool acceleratorValid {false};
+
       //! Voxel type.
       std::string voxelType;
 
@@ -0,0 +1,289 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+//ospray
+#include "TimeSeriesBlockBrickedVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using TimeSeriesBBV = TimeSeriesBlockBrickedVolume;
+
+    //! Slices loaded at once: one layer of blocks.
+    static constexpr int SLAB_SLICES = 64;
+
+    //! Whether a printf() pattern consumes exactly one int argument, with no
+    //! other conversions ("%%" excepted).
+    static bool takesOneStepIndex(const std::string &pattern)
+    {
+      int conversions = 0;
+
+      for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%')
+          continue;
+
+        if (++i < pattern.size() && pattern[i] == '%')
+          continue;
+
+        // Flags, field width and precision (but no '*' arguments).
+        while (i < pattern.size() && std::strchr("-+ #0", pattern[i]))
+          ++i;
+        while (i < pattern.size() && std::isdigit((unsigned char)pattern[i]))
+          ++i;
+        if (i < pattern.size() && pattern[i] == '.') {
+          ++i;
+          while (i < pattern.size() && std::isdigit((unsigned char)pattern[i]))
+            ++i;
+        }
+
+        if (i == pattern.size() || !std::strchr("diouxX", pattern[i]))
+          return false;
+
+        conversions++;
+      }
+
+      return conversions == 1;
+    }
+
+    // TimeSeriesBlockBrickedVolume definitions ///////////////////////////////
+
+    TimeSeriesBBV::~TimeSeriesBlockBrickedVolume()
+    {
+      if (pendingLoad.valid())
+        pendingLoad.wait();
+
+      delete [] backBlockMem;
+    }
+
+    std::string TimeSeriesBBV::toString() const
+    {
+      return("ospray::cpp_renderer::TimeSeriesBBV<" + voxelType + ">");
+    }
+
+    void TimeSeriesBBV::commit()
+    {
+      filenamePattern = getParamString("filenamePattern", "");
+      numTimeSteps    = getParam1i("numTimeSteps", 0);
+
+      exitOnCondition(filenamePattern.empty() || numTimeSteps <= 0,
+                      "time series volumes need 'filenamePattern' and "
+                      "'numTimeSteps'");
+      exitOnCondition(!takesOneStepIndex(filenamePattern),
+                      "'filenamePattern' must contain exactly one integer "
+                      "conversion (e.g. %04d) for the time step");
+
+      if (!backBlockMem)
+        constructTimeSeriesMemory();
+
+      // The loader runs in the background, so it gets the parameters it
+      // needs as a snapshot instead of reading them concurrently.
+      histogramParams = getHistogramParams(voxel_t);
+
+      const int step = clamp(getParam1i("timeStep", 0), 0, numTimeSteps - 1);
+
+      if (step != currentStep) {
+        // Seeking to a step other than the one prefetched loads it now.
+        if (step != backStep) {
+          waitForPrefetch();
+          prefetch(step);
+        }
+
+        // Only stalls if playback outpaces streaming from disk.
+        waitForPrefetch();
+
+        std::swap(blockMem, backBlockMem);
+        std::swap(accelerator.cellRange, backAccelerator.cellRange);
+        std::swap(currentStep, backStep);
+        gradientCacheValid = false;
+
+        // "voxelRange" and "histogram" describe the step on display.
+        {
+          std::lock_guard<std::mutex> lock(statisticsMutex);
+          statistics        = VoxelStatistics{};
+          partialStatistics = std::move(backStatistics);
+          backStatistics.clear();
+        }
+
+        if (numTimeSteps > 1)
+          prefetch((step + 1) % numTimeSteps);
+      }
+
+      BlockBrickedVolume::commit();
+    }
+
+    void TimeSeriesBBV::buildAccelerator()
+    {
+    }
+
+    void TimeSeriesBBV::constructTimeSeriesMemory()
+    {
+      constructVolumeMemory();
+
+      exitOnCondition(sparse, "sparse time series volumes are not supported");
+
+      backBlockMem = new byte_t[blockStride[2] * blockCount.z * voxelSize];
+
+      accelerator.resize(dimensions);
+      backAccelerator.resize(dimensions);
+    }
+
+    void TimeSeriesBBV::prefetch(int step)
+    {
+      backStep    = step;
+
+      const std::string fileName      = timeStepFileName(step);
+      const HistogramParams histogram = histogramParams;
+      pendingLoad = std::async(std::launch::async,
+                               [=]() { loadTimeStep(fileName, histogram); });
+    }
+
+    void TimeSeriesBBV::waitForPrefetch()
+    {
+      if (!pendingLoad.valid())
+        return;
+
+      try {
+        pendingLoad.get();
+      } catch (...) {
+        // The back buffer holds a partially loaded step.
+        backStep = -1;
+        throw;
+      }
+    }
+
+    void TimeSeriesBBV::loadTimeStep(const std::string &fileName,
+                                     const HistogramParams &histogram)
+    {
+
+      FILE *file = std::fopen(fileName.c_str(), "rb");
+      if (!file)
+        throw std::runtime_error("could not open time step '" + fileName + "'");
+
+      const size_t sliceSize = size_t(dimensions.x) * dimensions.y * voxelSize;
+
+      {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        backStatistics.clear();
+      }
+
+      // Each slab also holds the first slice of the next one, so the cells
+      // starting in the slab see all of their voxels.
+      std::vector<byte_t> slab(sliceSize * (SLAB_SLICES + 1));
+
+      for (int z0 = 0; z0 < dimensions.z; z0 += SLAB_SLICES) {
+        const int z1 = std::min(z0 + SLAB_SLICES + 1, dimensions.z);
+
+        // The slice shared with the previous slab is already at the front.
+        const int carried   = z0 > 0 ? 1 : 0;
+        const size_t toRead = sliceSize * (z1 - z0 - carried);
+
+        if (std::fread(slab.data() + carried * sliceSize, 1, toRead, file)
+            != toRead) {
+          std::fclose(file);
+          throw std::runtime_error("time step '" + fileName + "' is truncated");
+        }
+
+        loadRegion(backBlockMem, slab.data(), vec3i(0, 0, z0),
+                   vec3i(dimensions.x, dimensions.y, z1 - z0));
+
+        // The slice shared with the next slab is counted there.
+        const int slices = std::min(SLAB_SLICES, dimensions.z - z0);
+        collectStatistics(voxel_t, slab.data(), vec3i(0, 0, z0),
+                          vec3i(dimensions.x, dimensions.y, slices),
+                          histogram, backStatistics);
+
+        switch (voxel_t) {
+        case OSP_UCHAR:
+          buildCellRanges((const uint8*)slab.data(), z0);
+          break;
+        case OSP_SHORT:
+          buildCellRanges((const int16*)slab.data(), z0);
+          break;
+        case OSP_USHORT:
+          buildCellRanges((const uint16*)slab.data(), z0);
+          break;
+        case OSP_FLOAT:
+          buildCellRanges((const float*)slab.data(), z0);
+          break;
+        case OSP_DOUBLE:
+          buildCellRanges((const double*)slab.data(), z0);
+          break;
+        default:
+          break;
+        }
+
+        std::memmove(slab.data(), slab.data() + (z1 - 1 - z0) * sliceSize,
+                     sliceSize);
+      }
+
+      std::fclose(file);
+    }
+
+    template <typename T>
+    void TimeSeriesBBV::buildCellRanges(const T *slab, int z0)
+    {
+      const vec3i cellCount = backAccelerator.cellCount;
+
+      const int cz0 = z0 / GridAccelerator::CELL_WIDTH;
+      const int cz1 = std::min((z0 + SLAB_SLICES) / GridAccelerator::CELL_WIDTH,
+                               cellCount.z);
+
+      if (cz0 >= cz1)
+        return;
+
+      const size_t cellsPerLayer = size_t(cellCount.x) * cellCount.y;
+
+      tasking::parallel_for(cellsPerLayer * (cz1 - cz0), [&](size_t i) {
+        const vec3i cellIndex {int(i % cellCount.x),
+                               int((i / cellCount.x) % cellCount.y),
+                               cz0 + int(i / cellsPerLayer)};
+
+        const box3i voxels = backAccelerator.cellVoxels(cellIndex);
+
+        vec2f range {FLT_MAX, -FLT_MAX};
+
+        for (int z = voxels.lower.z; z <= voxels.upper.z; ++z) {
+          for (int y = voxels.lower.y; y <= voxels.upper.y; ++y) {
+            const T *run = slab + dimensions.x
+              * (y + uint64(dimensions.y) * (z - z0));
+
+            for (int x = voxels.lower.x; x <= voxels.upper.x; ++x) {
+              range.x = ospcommon::min(range.x, float(run[x]));
+              range.y = ospcommon::max(range.y, float(run[x]));
+            }
+          }
+        }
+
+        backAccelerator.cellRange[backAccelerator.cellID(cellIndex)] = range;
+      });
+    }
+
+    std::string TimeSeriesBBV::timeStepFileName(int step) const
+    {
+      char fileName[4096];
+      std::snprintf(fileName, sizeof(fileName), filenamePattern.c_str(), step);
+      return fileName;
+    }
+
+    OSP_REGISTER_VOLUME(TimeSeriesBlockBrickedVolume, cpp_time_series_bbv);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,95 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "BlockBrickedVolume.h"
+// std
+#include <future>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Block bricked volume playing back a series of time steps, each stored
+        in a raw file of voxels in 3D-array order. While a step is rendered,
+        the next one is streamed from disk into a back buffer by a background
+        thread; committing "timeStep" then only swaps the buffers. */
+    class TimeSeriesBlockBrickedVolume : public BlockBrickedVolume
+    {
+    public:
+
+      ~TimeSeriesBlockBrickedVolume();
+
+      std::string toString() const override;
+
+      void commit() override;
+
+    private:
+
+      //! The macrocells of each step are built while it is being loaded.
+      void buildAccelerator() override;
+
+      void constructTimeSeriesMemory();
+
+      //! Start loading 'step' into the back buffer in the background.
+      void prefetch(int step);
+
+      //! Wait for the pending load (if any), rethrowing its errors.
+      void waitForPrefetch();
+
+      //! Stream a step from disk into the back buffer, its macrocells and its
+      //! statistics. Runs in the background, so it must not read parameters
+      //! (or members the commit thread writes).
+      void loadTimeStep(const std::string &fileName,
+                        const HistogramParams &histogram);
+
+      //! Macrocell ranges of the cells starting in slices [z0, z0 + SLAB).
+      template <typename T>
+      void buildCellRanges(const T *slab, int z0);
+
+      std::string timeStepFileName(int step) const;
+
+      // Data //
+
+      //! printf() pattern of the time step files, taking the step index.
+      std::string filenamePattern;
+
+      int numTimeSteps {0};
+
+      //! Histogram settings of the last commit, handed to the loader.
+      HistogramParams histogramParams;
+
+      //! Step held by the front buffer ('blockMem'), -1 if none.
+      int currentStep {-1};
+
+      //! Step held (or being loaded) by the back buffer, -1 if none.
+      int backStep {-1};
+
+      //! Back buffer, laid out like 'blockMem'.
+      byte_t *backBlockMem {nullptr};
+
+      //! Macrocells of the step in the back buffer.
+      GridAccelerator backAccelerator;
+
+      //! Value range and histogram of the step in the back buffer, published
+      //! once it is swapped to the front.
+      std::vector<VoxelStatistics> backStatistics;
+
+      std::future<void> pendingLoad;
+    };
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
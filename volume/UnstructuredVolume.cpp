@@ -0,0 +1,581 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+//ospray
+#include "UnstructuredVolume.h"
+#include "ospcommon/tasking/parallel_for.h"
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    using UV = UnstructuredVolume;
+
+    static std::atomic<size_t> nextVolumeID {1};
+
+    // Cell which held the last sample located by this thread, per volume.
+    // The scalar renderer's consecutive samples belong to one ray; the stream
+    // renderer visits samples in brick order and the packet renderer samples
+    // neighboring rays, so there the previous sample is still close by.
+    struct CellCache
+    {
+      static constexpr int SIZE = 4;
+
+      struct Entry
+      {
+        size_t volumeID {0};
+        size_t commit   {0};
+        int    cellID   {-1};
+      };
+
+      Entry entries[SIZE];
+      int next {0};
+
+      //! The entry of a volume (reset if the volume was committed since), or
+      //! a recycled one if there is none, so interleaved volumes keep theirs.
+      Entry &find(size_t volumeID, size_t commit)
+      {
+        for (auto &entry : entries) {
+          if (entry.volumeID == volumeID) {
+            if (entry.commit != commit)
+              entry = Entry{volumeID, commit, -1};
+            return entry;
+          }
+        }
+
+        Entry &entry = entries[next];
+        next = (next + 1) % SIZE;
+
+        entry = Entry{volumeID, commit, -1};
+        return entry;
+      }
+    };
+
+    static thread_local CellCache cellCache;
+
+    //! Tolerance on barycentric coordinates for points on shared faces.
+    static constexpr float BARYCENTRIC_EPSILON = 1e-5f;
+
+    UV::UnstructuredVolume() : volumeID(nextVolumeID++)
+    {
+    }
+
+    std::string UV::toString() const
+    {
+      return "ospray::cpp_renderer::UnstructuredVolume";
+    }
+
+    void UV::commit()
+    {
+      cpp_renderer::Volume::commit();
+
+      auto *vertexData   = getParamData("vertices", nullptr);
+      auto *fieldData    = getParamData("field", nullptr);
+      auto *indexData    = getParamData("indices", nullptr);
+      auto *hexIndexData = getParamData("hexIndices", nullptr);
+
+      exitOnCondition(vertexData == nullptr ||
+                      vertexData->type != OSP_FLOAT3,
+                      "unstructured volumes need float3 'vertices'");
+      exitOnCondition(fieldData == nullptr ||
+                      fieldData->type != OSP_FLOAT ||
+                      fieldData->numItems != vertexData->numItems,
+                      "unstructured volumes need one float 'field' value "
+                      "per vertex");
+      exitOnCondition(indexData == nullptr && hexIndexData == nullptr,
+                      "unstructured volumes need 'indices' or 'hexIndices'");
+
+      // Values may change without the mesh, which is only rebuilt when its
+      // arrays are replaced.
+      field.resize(fieldData->numItems);
+      memcpy(field.data(), fieldData->data, fieldData->numBytes);
+
+      if (vertexData   != vertexArray.ptr ||
+          indexData    != indexArray.ptr  ||
+          hexIndexData != hexIndexArray.ptr) {
+        vertexArray   = vertexData;
+        indexArray    = indexData;
+        hexIndexArray = hexIndexData;
+
+        vertices.resize(vertexData->numItems);
+        memcpy(vertices.data(), vertexData->data, vertexData->numBytes);
+
+        gatherCells();
+        buildCells();
+      }
+    }
+
+    int UV::setRegion(const void *source,
+                      const vec3i &index,
+                      const vec3i &count)
+    {
+      UNUSED(source, index, count);
+      return 0;
+    }
+
+    void UV::computeSamples(float **results,
+                            const vec3f *worldCoordinates,
+                            const size_t &count)
+    {
+      *results = (float*)malloc(count * sizeof(float));
+      exitOnCondition(*results == nullptr, "error allocating memory");
+
+      float *samples = *results;
+
+      // Neighboring points are likely close, so each task walks through a
+      // contiguous chunk of them.
+      static constexpr size_t CHUNK_SIZE = 4096;
+      const size_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+      tasking::parallel_for(numChunks, [&](size_t chunkID) {
+        const size_t begin = chunkID * CHUNK_SIZE;
+        const size_t end   = std::min(begin + CHUNK_SIZE, count);
+
+        for (size_t i = begin; i < end; ++i)
+          samples[i] = computeSample(worldCoordinates[i]);
+      });
+    }
+
+    float UV::computeSample(const vec3f &worldCoordinates) const
+    {
+      const int cellID = locateCell(worldCoordinates);
+
+      if (cellID < 0)
+        return std::numeric_limits<float>::quiet_NaN();
+
+      return interpolate(cellID, barycentrics(cellID, worldCoordinates));
+    }
+
+    vec3f UV::computeGradient(const vec3f &worldCoordinates) const
+    {
+      const int cellID = locateCell(worldCoordinates);
+
+      if (cellID < 0)
+        return vec3f{0.f};
+
+      const vec4i &cell     = cells[cellID];
+      const TetFrame &frame = frames[cellID];
+
+      const float f0 = field[cell.x];
+
+      return frame.rows[0] * (field[cell.y] - f0)
+             + frame.rows[1] * (field[cell.z] - f0)
+             + frame.rows[2] * (field[cell.w] - f0);
+    }
+
+    bool UV::intersect(Ray &ray) const
+    {
+      auto hits = intersectBox(ray, boundingBox);
+
+      if (hits.first < hits.second && hits.first < ray.t &&
+          clipInterval(ray.org, ray.dir, hits.first, hits.second)) {
+        ray.t0 = hits.first;
+        ray.t  = hits.second;
+        return true;
+      } else {
+        return false;
+      }
+    }
+
+    void UV::advance(Ray &ray, float stepScale) const
+    {
+      ray.t0 += stepScale * samplingStep / samplingRate;
+    }
+
+    bool UV::advanceAdaptive(Ray &ray,
+                             float &lastStep,
+                             float sampleOpacity,
+                             float stepScale) const
+    {
+      const float maxRate  = ospcommon::max(samplingRate,
+                                            adaptiveMaxSamplingRate);
+      const float rate     = clamp(adaptiveScalar * sampleOpacity,
+                                   samplingRate, maxRate);
+      const float step     = stepScale * samplingStep / rate;
+
+      // Retake a large step which jumped into an opaque feature.
+      if (sampleOpacity > adaptiveBacktrack && lastStep > 1.25f * step) {
+        ray.t0  += step - lastStep;
+        lastStep = step;
+        return false;
+      }
+
+      ray.t0  += step;
+      lastStep = step;
+
+      return true;
+    }
+
+    void UV::intersectIsosurface(const std::vector<float> &isovalues,
+                                 Ray &ray) const
+    {
+      if (isovalues.empty())
+        return;
+
+      // Only the (clipped) interval found by intersect() is searched.
+      const float tEnd = ray.t;
+
+      if (!(ray.t0 < tEnd))
+        return;
+
+      const float step = samplingStep / samplingRate;
+
+      auto valueAt = [&](float t) {
+        return computeSample(ray.org + t * ray.dir);
+      };
+
+      float t0 = ray.t0;
+      float v0 = valueAt(t0);
+
+      while (t0 < tEnd) {
+        const float t1 = ospcommon::min(t0 + step, tEnd);
+        const float v1 = valueAt(t1);
+
+        // Samples outside of the mesh bracket no crossing.
+        if (!std::isnan(v0) && !std::isnan(v1)) {
+          float tHit  = inf;
+          int   isoID = -1;
+
+          for (size_t i = 0; i < isovalues.size(); ++i) {
+            const float iso = isovalues[i];
+            if ((v0 < iso) != (v1 < iso)) {
+              const float tIso = refineIsosurfaceHit(ray, iso, t0, v0, t1, v1);
+              if (tIso < tHit) {
+                tHit  = tIso;
+                isoID = i;
+              }
+            }
+          }
+
+          if (isoID >= 0) {
+            ray.t      = tHit;
+            ray.primID = isoID;
+            ray.Ng     = computeGradient(ray.org + tHit * ray.dir);
+            return;
+          }
+        }
+
+        t0 = t1;
+        v0 = v1;
+      }
+    }
+
+    size_t UV::brickID(const vec3f &worldCoordinates) const
+    {
+      // Cells of a 64^3 grid over the bounds: points sharing a key are close,
+      // and so likely in the same or in neighboring tetrahedra.
+      const vec3f extent = max(boundingBox.size(), vec3f{1e-6f});
+      const vec3f local  = clamp((worldCoordinates - boundingBox.lower)
+                                 * (64.f / extent),
+                                 vec3f{0.f}, vec3f{63.f});
+
+      const vec3i cell = vec3i(local);
+
+      return (size_t(cell.z) << 12) | (cell.y << 6) | cell.x;
+    }
+
+    // SIMD interface /////////////////////////////////////////////////////////
+
+    simd::vfloat UV::computeSample(simd::vmaski active,
+                                   const simd::vec3f &worldCoordinates) const
+    {
+      simd::vfloat samples {0.f};
+
+      simd::foreach_active(active, [&](int i) {
+        samples[i] = computeSample(vec3f{worldCoordinates.x[i],
+                                         worldCoordinates.y[i],
+                                         worldCoordinates.z[i]});
+      });
+
+      return samples;
+    }
+
+    simd::vmaski UV::intersect(simd::vmaski active, RayN &ray) const
+    {
+      auto hits = intersectBox(ray, boundingBox);
+
+      auto hit = active & (hits.first < hits.second) & (hits.first < ray.t);
+      hit = clipInterval(hit, ray.org, ray.dir, hits.first, hits.second);
+
+      ray.t0 = simd::select(hit, hits.first, ray.t0);
+      ray.t  = simd::select(hit, hits.second, ray.t);
+
+      return hit;
+    }
+
+    void UV::advance(simd::vmaski active, RayN &ray) const
+    {
+      const float step = samplingStep / samplingRate;
+
+      ray.t0 = simd::select(active, ray.t0 + step, ray.t0);
+    }
+
+    simd::vmaski UV::advanceAdaptive(simd::vmaski active,
+                                     RayN &ray,
+                                     simd::vfloat &lastStep,
+                                     const simd::vfloat &sampleOpacity) const
+    {
+      const float maxRate = ospcommon::max(samplingRate,
+                                           adaptiveMaxSamplingRate);
+
+      simd::vfloat rate = adaptiveScalar * sampleOpacity;
+      rate = simd::select(rate > samplingRate, rate, samplingRate);
+      rate = simd::select(rate < maxRate, rate, maxRate);
+
+      const simd::vfloat step = samplingStep / rate;
+
+      const auto backtrack = active
+                             & (sampleOpacity > adaptiveBacktrack)
+                             & (lastStep > 1.25f * step);
+      const auto accepted  = active & !backtrack;
+
+      ray.t0 = simd::select(backtrack, ray.t0 + step - lastStep,
+                            simd::select(accepted, ray.t0 + step, ray.t0));
+      lastStep = simd::select(active, step, lastStep);
+
+      return accepted;
+    }
+
+    // Helper functions ///////////////////////////////////////////////////////
+
+    void UV::gatherCells()
+    {
+      cells.clear();
+
+      if (indexArray.ptr) {
+        exitOnCondition(indexArray->type != OSP_INT4,
+                        "unstructured volume 'indices' must be int4");
+
+        cells.resize(indexArray->numItems);
+        memcpy(cells.data(), indexArray->data, indexArray->numBytes);
+      }
+
+      if (hexIndexArray.ptr) {
+        exitOnCondition(hexIndexArray->type != OSP_INT &&
+                        hexIndexArray->type != OSP_INT4,
+                        "unstructured volume 'hexIndices' must be int");
+
+        const int *hex = (const int*)hexIndexArray->data;
+        const size_t numHexes = hexIndexArray->numBytes / (8 * sizeof(int));
+
+        // Six tetrahedra around the diagonal from vertex 0 to vertex 6 (VTK
+        // vertex order: 0-3 counterclockwise at the bottom, 4-7 at the top).
+        static const int tets[6][4] = {{0, 1, 2, 6}, {0, 2, 3, 6},
+                                       {0, 3, 7, 6}, {0, 7, 4, 6},
+                                       {0, 4, 5, 6}, {0, 5, 1, 6}};
+
+        for (size_t h = 0; h < numHexes; ++h, hex += 8) {
+          for (const auto &tet : tets) {
+            cells.push_back(vec4i{hex[tet[0]], hex[tet[1]],
+                                  hex[tet[2]], hex[tet[3]]});
+          }
+        }
+      }
+
+      const int numVertices = vertices.size();
+
+      exitOnCondition(std::any_of(cells.begin(), cells.end(),
+                                  [&](const vec4i &c) {
+                                    return reduce_min(c) < 0 ||
+                                           reduce_max(c) >= numVertices;
+                                  }),
+                      "unstructured volume indices out of range");
+
+      // Flat tetrahedra contain no points.
+      cells.erase(std::remove_if(cells.begin(), cells.end(),
+                                 [&](const vec4i &c) {
+                                   const vec3f &v0 = vertices[c.x];
+                                   return dot(vertices[c.y] - v0,
+                                              cross(vertices[c.z] - v0,
+                                                    vertices[c.w] - v0))
+                                          == 0.f;
+                                 }),
+                  cells.end());
+    }
+
+    void UV::buildCells()
+    {
+      const size_t numCells = cells.size();
+
+      boundingBox = empty;
+      for (const auto &v : vertices)
+        boundingBox.extend(v);
+
+      frames.resize(numCells);
+      neighbors.assign(numCells, vec4i{-1});
+
+      std::vector<box3f> cellBounds(numCells);
+
+      // Typical cell width (that of a cube made of six such tetrahedra),
+      // summed per task for the sampling step.
+      static constexpr size_t CHUNK_SIZE = 4096;
+      const size_t numChunks = (numCells + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+      std::vector<double> cellWidths(numChunks, 0.0);
+
+      tasking::parallel_for(numChunks, [&](size_t chunkID) {
+        const size_t begin = chunkID * CHUNK_SIZE;
+        const size_t end   = std::min(begin + CHUNK_SIZE, numCells);
+
+        for (size_t i = begin; i < end; ++i) {
+          const vec4i &c = cells[i];
+
+          const vec3f &v0 = vertices[c.x];
+          const vec3f e1  = vertices[c.y] - v0;
+          const vec3f e2  = vertices[c.z] - v0;
+          const vec3f e3  = vertices[c.w] - v0;
+
+          // Rows of the inverse of the matrix with columns e1, e2, e3.
+          const float det = dot(e1, cross(e2, e3));
+
+          frames[i].rows[0] = cross(e2, e3) / det;
+          frames[i].rows[1] = cross(e3, e1) / det;
+          frames[i].rows[2] = cross(e1, e2) / det;
+
+          box3f bounds = empty;
+          bounds.extend(v0);
+          bounds.extend(vertices[c.y]);
+          bounds.extend(vertices[c.z]);
+          bounds.extend(vertices[c.w]);
+          cellBounds[i] = bounds;
+
+          cellWidths[chunkID] += std::cbrt(std::abs(det));
+        }
+      });
+
+      double widthSum = 0.0;
+      for (const double width : cellWidths)
+        widthSum += width;
+
+      samplingStep = numCells > 0 ? float(widthSum / numCells) : 1.f;
+
+      // Match up the faces shared by two cells: faces are keyed by their
+      // sorted vertex indices, so sorting puts shared faces next to each
+      // other.
+      struct Face
+      {
+        std::array<int, 3> vertexIDs;
+        int cellID;
+        int opposite;
+      };
+
+      std::vector<Face> faces(4 * numCells);
+
+      tasking::parallel_for(numCells, [&](size_t i) {
+        const int v[4] = {cells[i].x, cells[i].y, cells[i].z, cells[i].w};
+
+        for (int k = 0; k < 4; ++k) {
+          Face &face = faces[4 * i + k];
+          face.vertexIDs = {v[(k + 1) % 4], v[(k + 2) % 4], v[(k + 3) % 4]};
+          std::sort(face.vertexIDs.begin(), face.vertexIDs.end());
+          face.cellID   = i;
+          face.opposite = k;
+        }
+      });
+
+      std::sort(faces.begin(), faces.end(), [](const Face &a, const Face &b) {
+        return a.vertexIDs < b.vertexIDs;
+      });
+
+      auto setNeighbor = [&](const Face &face, int neighbor) {
+        auto &n = neighbors[face.cellID];
+        switch (face.opposite) {
+        case 0: n.x = neighbor; break;
+        case 1: n.y = neighbor; break;
+        case 2: n.z = neighbor; break;
+        default: n.w = neighbor; break;
+        }
+      };
+
+      for (size_t i = 0; i + 1 < faces.size(); ++i) {
+        if (faces[i].vertexIDs == faces[i + 1].vertexIDs) {
+          setNeighbor(faces[i], faces[i + 1].cellID);
+          setNeighbor(faces[i + 1], faces[i].cellID);
+          ++i;
+        }
+      }
+
+      bvh.build(cellBounds);
+    }
+
+    vec4f UV::barycentrics(int cellID, const vec3f &p) const
+    {
+      const TetFrame &frame = frames[cellID];
+      const vec3f d = p - vertices[cells[cellID].x];
+
+      const float b1 = dot(frame.rows[0], d);
+      const float b2 = dot(frame.rows[1], d);
+      const float b3 = dot(frame.rows[2], d);
+
+      return vec4f{1.f - b1 - b2 - b3, b1, b2, b3};
+    }
+
+    int UV::locateCell(const vec3f &p) const
+    {
+      auto &cache = cellCache.find(volumeID, commitCount);
+
+      // Walk from the cached cell through the face the point lies beyond
+      // the most, as long as there is a neighbor across it.
+      int cellID = cache.cellID < int(cells.size()) ? cache.cellID : -1;
+
+      for (int step = 0; cellID >= 0 && step < MAX_WALK_STEPS; ++step) {
+        const vec4f b = barycentrics(cellID, p);
+        const float coordinates[4] = {b.x, b.y, b.z, b.w};
+
+        int exitFace = 0;
+        for (int k = 1; k < 4; ++k) {
+          if (coordinates[k] < coordinates[exitFace])
+            exitFace = k;
+        }
+
+        if (coordinates[exitFace] >= -BARYCENTRIC_EPSILON) {
+          cache.cellID = cellID;
+          return cellID;
+        }
+
+        const vec4i &n = neighbors[cellID];
+        const int next[4] = {n.x, n.y, n.z, n.w};
+        cellID = next[exitFace];
+      }
+
+      cellID = bvh.locate(p, [&](int id) {
+        return reduce_min(barycentrics(id, p)) >= -BARYCENTRIC_EPSILON;
+      });
+
+      if (cellID >= 0)
+        cache.cellID = cellID;
+
+      return cellID;
+    }
+
+    float UV::interpolate(int cellID, const vec4f &b) const
+    {
+      const vec4i &cell = cells[cellID];
+
+      return b.x * field[cell.x] + b.y * field[cell.y]
+             + b.z * field[cell.z] + b.w * field[cell.w];
+    }
+
+    OSP_REGISTER_VOLUME(UnstructuredVolume, cpp_unstructured_volume);
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
@@ -0,0 +1,143 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "common/Data.h"
+#include "Volume.h"
+#include "CellBVH.h"
+
+namespace ospray {
+  namespace cpp_renderer {
+
+    /*! Volume over a tetrahedral mesh with one value per vertex, interpolated
+        linearly (barycentrically) inside each tetrahedron. Hexahedra are
+        split into six tetrahedra at commit. Points are located by walking
+        from the cell which held the thread's previous sample of the volume
+        (usually close by, e.g. on the same ray) across faces towards the
+        point, and through a cell BVH when the walk fails. */
+    class UnstructuredVolume : public Volume
+    {
+    public:
+
+      UnstructuredVolume();
+
+      std::string toString() const override;
+
+      void commit() override;
+
+      //! Unstructured volumes take their values from "field" (this fails).
+      int setRegion(const void *source,
+                    const vec3i &index,
+                    const vec3i &count) override;
+
+      void computeSamples(float **results,
+                          const vec3f *worldCoordinates,
+                          const size_t &count) override;
+
+      // cpp_renderer::Volume interface //
+
+      //! Interpolated value at the given point, NaN outside of the mesh.
+      float computeSample(const vec3f &worldCoordinates) const override;
+
+      //! The (constant) gradient of the cell holding the point.
+      vec3f computeGradient(const vec3f &worldCoordinates) const override;
+
+      bool intersect(Ray &ray) const override;
+
+      void advance(Ray &ray, float stepScale) const override;
+      bool advanceAdaptive(Ray &ray,
+                           float &lastStep,
+                           float sampleOpacity,
+                           float stepScale) const override;
+
+      void intersectIsosurface(const std::vector<float> &isovalues,
+                               Ray &ray) const override;
+
+      size_t brickID(const vec3f &worldCoordinates) const override;
+
+      simd::vfloat computeSample(simd::vmaski active,
+                                 const simd::vec3f &worldCoordinates)
+                                 const override;
+
+      simd::vmaski intersect(simd::vmaski active, RayN &ray) const override;
+
+      void advance(simd::vmaski active, RayN &ray) const override;
+
+      simd::vmaski advanceAdaptive(simd::vmaski active,
+                                   RayN &ray,
+                                   simd::vfloat &lastStep,
+                                   const simd::vfloat &sampleOpacity)
+                                   const override;
+
+    private:
+
+      //! Inverse edge matrix of a tetrahedron: the barycentric coordinates of
+      //! 'p' for vertices 1..3 are dot(rows[k], p - vertex 0).
+      struct TetFrame
+      {
+        vec3f rows[3];
+      };
+
+      // Helper functions //
+
+      //! Gather the tetrahedra of the "indices" and "hexIndices" arrays.
+      void gatherCells();
+
+      //! Compute the frames, bounds and face neighbors of the cells, and
+      //! build the BVH over them.
+      void buildCells();
+
+      //! Barycentric coordinates of 'p' in cell 'cellID'.
+      vec4f barycentrics(int cellID, const vec3f &p) const;
+
+      //! The cell containing 'p', or -1.
+      int locateCell(const vec3f &p) const;
+
+      float interpolate(int cellID, const vec4f &barycentrics) const;
+
+      // Data //
+
+      //! Arrays the mesh was last built from; it is rebuilt when any of them
+      //! is replaced.
+      Ref<Data> vertexArray;
+      Ref<Data> indexArray;
+      Ref<Data> hexIndexArray;
+
+      std::vector<vec3f> vertices;
+      std::vector<float> field;
+
+      //! Vertex indices of each tetrahedron.
+      std::vector<vec4i> cells;
+
+      std::vector<TetFrame> frames;
+
+      //! Neighbor across the face opposite of each vertex (-1 on the mesh
+      //! boundary).
+      std::vector<vec4i> neighbors;
+
+      CellBVH bvh;
+
+      //! Identifies this volume in the cell caches of the sampling threads.
+      size_t volumeID;
+
+      //! Longest walk across faces before falling back to the BVH.
+      static constexpr int MAX_WALK_STEPS = 8;
+    };
+
+  } // ::ospray::cpp_renderer
+} // ::ospray
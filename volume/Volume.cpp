@@ -20,20 +20,144 @@
 namespace ospray {
   namespace cpp_renderer {
 
+    Volume::~Volume()
+    {
+      if (transferFunction)
+        transferFunction->requirePreIntegration(this, false);
+    }
+
     std::string Volume::toString() const
     {
       return("ospray::cpp_renderer::Volume");
     }
 
+    float Volume::computeSampleLOD(const vec3f &worldCoordinates,
+                                   float footprint) const
+    {
+      UNUSED(footprint);
+      return computeSample(worldCoordinates);
+    }
+
+    int Volume::levelOfDetail(float footprint) const
+    {
+      UNUSED(footprint);
+      return 0;
+    }
+
+    float Volume::refineIsosurfaceHit(const Ray &ray,
+                                      float isovalue,
+                                      float ta, float va,
+                                      float tb, float vb) const
+    {
+      // Secant steps which keep the crossing bracketed (regula falsi).
+      auto secant = [&]() {
+        return ta + (isovalue - va) * (tb - ta) / (vb - va);
+      };
+
+      for (int i = 0; i < 3; ++i) {
+        const float tm = secant();
+        const float vm = computeSample(ray.org + tm * ray.dir);
+
+        if ((va < isovalue) == (vm < isovalue)) {
+          ta = tm;
+          va = vm;
+        } else {
+          tb = tm;
+          vb = vm;
+        }
+      }
+
+      return secant();
+    }
+
+    vec3f Volume::computeShadingNormal(const vec3f &worldCoordinates) const
+    {
+      const vec3f gradient = computeGradient(worldCoordinates);
+      const float len = length(gradient);
+      return len > 0.f ? gradient / len : vec3f(0.f);
+    }
+
+    bool Volume::clipInterval(const vec3f &origin,
+                              const vec3f &direction,
+                              float &t0,
+                              float &t1) const
+    {
+      if (clippingBoxEnabled) {
+        const vec3f rcpDir = rcp(direction);
+        const vec3f mins = (volumeClippingBox.lower - origin) * rcpDir;
+        const vec3f maxs = (volumeClippingBox.upper - origin) * rcpDir;
+
+        t0 = ospcommon::max(t0, reduce_max(ospcommon::min(mins, maxs)));
+        t1 = ospcommon::min(t1, reduce_min(ospcommon::max(mins, maxs)));
+      }
+
+      for (const auto &plane : clipPlanes) {
+        const vec3f normal {plane.x, plane.y, plane.z};
+
+        const float cosND = dot(normal, direction);
+        const float dist  = dot(normal, origin) + plane.w;
+
+        // Entering the kept half-space trims the start, leaving it the end.
+        if (cosND > 0.f)
+          t0 = ospcommon::max(t0, -dist / cosND);
+        else if (cosND < 0.f)
+          t1 = ospcommon::min(t1, -dist / cosND);
+        else if (dist < 0.f)
+          return false;
+      }
+
+      return t0 < t1;
+    }
+
+    simd::vmaski Volume::clipInterval(simd::vmaski active,
+                                      const simd::vec3f &origin,
+                                      const simd::vec3f &direction,
+                                      simd::vfloat &t0,
+                                      simd::vfloat &t1) const
+    {
+      if (clippingBoxEnabled) {
+        const simd::vec3f rcpDir = rcp(direction);
+        const simd::vec3f mins =
+            (simd::vec3f{volumeClippingBox.lower} - origin) * rcpDir;
+        const simd::vec3f maxs =
+            (simd::vec3f{volumeClippingBox.upper} - origin) * rcpDir;
+
+        t0 = simd::max(simd::max(simd::max(simd::min(mins.x, maxs.x),
+                                           simd::min(mins.y, maxs.y)),
+                                 simd::min(mins.z, maxs.z)), t0);
+        t1 = simd::min(simd::min(simd::min(simd::max(mins.x, maxs.x),
+                                           simd::max(mins.y, maxs.y)),
+                                 simd::max(mins.z, maxs.z)), t1);
+      }
+
+      for (const auto &plane : clipPlanes) {
+        const simd::vfloat cosND = plane.x * direction.x
+                                   + plane.y * direction.y
+                                   + plane.z * direction.z;
+        const simd::vfloat dist  = plane.x * origin.x
+                                   + plane.y * origin.y
+                                   + plane.z * origin.z + plane.w;
+
+        const simd::vfloat tPlane = -dist / cosND;
+
+        t0 = simd::select(cosND > 0.f, simd::max(t0, tPlane), t0);
+        t1 = simd::select(cosND < 0.f, simd::min(t1, tPlane), t1);
+
+        // Rays parallel to the plane are either kept or clipped entirely.
+        active = active & !((cosND == 0.f) & (dist < 0.f));
+      }
+
+      return active & (t0 < t1);
+    }
+
     void Volume::commit()
     {
       // Set the gradient shading flag for the renderer.
       gradientShadingEnabled  = getParam1i("gradientShadingEnabled", 0);
-      preIntegrationEnabled   = getParam1i("preIntegration", 0);
       singleShadingEnabled    = getParam1i("singleShade", 1);
       adaptiveSamplingEnabled = getParam1i("adaptiveSampling", 1);
       adaptiveScalar          = getParam1f("adaptiveScalar", 15.0f);
-      adaptiveMaxSamplingRate = getParam1f("adaptiveMaxSamplingRate", 0.7f);
+      adaptiveMaxSamplingRate = getParam1f("adaptiveMaxSamplingRate", 2.0f);
       adaptiveBacktrack       = getParam1f("adaptiveBacktrack", 0.03f);
 
       // Set the recommended sampling rate for ray casting based renderers.
@@ -45,13 +169,54 @@ namespace ospray {
       volumeClippingBox =
           box3f(getParam3f("volumeClippingBoxLower", vec3f(0.f)),
                 getParam3f("volumeClippingBoxUpper", vec3f(0.f)));
+
+      clippingBoxEnabled =
+          reduce_min(volumeClippingBox.upper - volumeClippingBox.lower) > 0.f;
+
+      // Set the clip planes, as vec4f(normal, offset).
+      auto *clipPlaneData = getParamData("clipPlanes", nullptr);
+
+      clipPlanes.clear();
+
+      if (clipPlaneData) {
+        exitOnCondition(clipPlaneData->type != OSP_FLOAT4,
+                        "clip planes must be an array of float4");
+        clipPlanes.resize(clipPlaneData->numItems);
+        memcpy(clipPlanes.data(), clipPlaneData->data, clipPlaneData->numBytes);
+      }
+
+      // Set the isovalues of implicit isosurfaces.
+      auto *isovalueData = getParamData("isovalues", nullptr);
+
+      isovalues.clear();
+
+      if (isovalueData) {
+        exitOnCondition(isovalueData->type != OSP_FLOAT,
+                        "isovalues must be an array of float");
+        isovalues.resize(isovalueData->numItems);
+        memcpy(isovalues.data(), isovalueData->data, isovalueData->numBytes);
+      }
+
       // Set the transfer function.
       auto *tf =
           dynamic_cast<TransferFunction *>(getParamObject("transferFunction",
                                                           nullptr));
       exitOnCondition(tf == nullptr, "no C++ transfer function specified!");
 
+      if (transferFunction && transferFunction.ptr != tf)
+        transferFunction->requirePreIntegration(this, false);
+
       transferFunction = tf;
+
+      // Pre-integration is enabled by either the volume's or the transfer
+      // function's "preIntegration"; the transfer function keeps the table
+      // only while some volume needs it.
+      preIntegrationEnabled = getParam1i("preIntegration", 0) ||
+                              tf->preIntegrationEnabled;
+
+      tf->requirePreIntegration(this, preIntegrationEnabled);
+
+      ++commitCount;
     }
 
   } // ::ospray::cpp_renderer
@@ -20,6 +20,7 @@
 #include "volume/Volume.h"
 // cpp_renderer
 #include "../common/Ray.h"
+#include "../common/RayN.h"
 #include "../transferFunction/TransferFunction.h"
 
 namespace ospray {
@@ -29,7 +30,7 @@ namespace ospray {
     {
     public:
 
-      virtual ~Volume() = default;
+      virtual ~Volume();
 
       virtual std::string toString() const override;
 
@@ -50,25 +51,94 @@ namespace ospray {
 
       virtual vec3f computeGradient(const vec3f &worldCoordinates) const = 0;
 
-      virtual bool intersect(Ray &ray) const = 0;
+      //! Unit gradient direction for shading, zero where the volume is flat
+      //! (normalized computeGradient() by default).
+      virtual vec3f computeShadingNormal(const vec3f &worldCoordinates) const;
 
-      virtual void advance(Ray &ray) const = 0;
-      virtual void advanceAdaptive(Ray &ray) const = 0;
+      virtual bool intersect(Ray &ray) const = 0;
 
+      //! Advance by the volume's step size, scaled by 'stepScale' (e.g. to
+      //! match the resolution level being sampled).
+      virtual void advance(Ray &ray, float stepScale) const = 0;
+
+      //! Advance by a step adapted to the opacity of the sample at 'ray.t0'.
+      //! 'lastStep' is the size of the step which reached that sample (0 for
+      //! the first sample) and is updated to the step taken. Returns false if
+      //! the ray backtracked, in which case the sample at the old 'ray.t0'
+      //! must be discarded.
+      virtual bool advanceAdaptive(Ray &ray,
+                                   float &lastStep,
+                                   float sampleOpacity,
+                                   float stepScale) const = 0;
+
+      //! Sample at the resolution matching 'footprint', the world space width
+      //! of a pixel at the sample position (full resolution by default).
+      virtual float computeSampleLOD(const vec3f &worldCoordinates,
+                                     float footprint) const;
+
+      //! Resolution level sampled for 'footprint' (0 is full resolution);
+      //! marching at level 'l' may use steps scaled by 2^l.
+      virtual int levelOfDetail(float footprint) const;
+
+      //! Find the first crossing of any isovalue in [ray.t0, ray.t] (e.g. the
+      //! clipped interval left by intersect()); nothing outside of it is
+      //! searched. On a hit 'ray.t' is set to the hit distance, 'ray.primID'
+      //! to the index of the isovalue and 'ray.Ng' to the (unnormalized)
+      //! gradient.
       virtual void intersectIsosurface(const std::vector<float> &isovalues,
                                        Ray &ray) const = 0;
 
+      //! Key identifying the storage brick read when sampling at the given
+      //! world coordinates; samples sharing a key touch the same memory.
+      virtual size_t brickID(const vec3f &worldCoordinates) const = 0;
+
+      //! Trim [t0, t1] to the clipping box and clip planes of the volume;
+      //! returns whether any of the interval is left.
+      bool clipInterval(const vec3f &origin,
+                        const vec3f &direction,
+                        float &t0,
+                        float &t1) const;
+
+      // SIMD interface //
+
+      virtual simd::vfloat computeSample(simd::vmaski active,
+                                         const simd::vec3f &worldCoordinates)
+                                         const = 0;
+
+      virtual simd::vmaski intersect(simd::vmaski active, RayN &ray) const = 0;
+
+      virtual void advance(simd::vmaski active, RayN &ray) const = 0;
+
+      //! Per-lane equivalent of advanceAdaptive(), returning the lanes whose
+      //! sample at the old 'ray.t0' is kept (i.e. which did not backtrack).
+      virtual simd::vmaski advanceAdaptive(simd::vmaski active,
+                                           RayN &ray,
+                                           simd::vfloat &lastStep,
+                                           const simd::vfloat &sampleOpacity)
+                                           const = 0;
+
+      //! Per-lane clipInterval(), returning the active lanes with any of
+      //! their interval left.
+      simd::vmaski clipInterval(simd::vmaski active,
+                                const simd::vec3f &origin,
+                                const simd::vec3f &direction,
+                                simd::vfloat &t0,
+                                simd::vfloat &t1) const;
+
       // Data //
 
       Ref<TransferFunction> transferFunction;
 
+      //! Isovalues rendered as implicit surfaces (none by default).
+      std::vector<float> isovalues;
+
       bool gradientShadingEnabled  {false};
       bool preIntegrationEnabled   {false};
       bool singleShadingEnabled    {true};
       bool adaptiveSamplingEnabled {true};
 
       float adaptiveScalar          {15.f};
-      float adaptiveMaxSamplingRate {0.7f};
+      float adaptiveMaxSamplingRate {2.f};
       float adaptiveBacktrack       {0.03f};
 
       float samplingRate {1.f};
@@ -77,6 +147,25 @@ namespace ospray {
 
       box3f boundingBox {vec3f{0.f}, vec3f{1.f}};
       box3f volumeClippingBox;
+
+      //! Whether 'volumeClippingBox' is set (it is empty by default).
+      bool clippingBoxEnabled {false};
+
+      //! Planes (normal, offset) removing the points 'p' where
+      //! dot(normal, p) + offset < 0.
+      std::vector<vec4f> clipPlanes;
+
+      //! Incremented by every commit, so data derived from the volume (e.g.
+      //! renderer caches) can tell when it is out of date.
+      size_t commitCount {0};
+
+    protected:
+
+      //! Refine an isovalue crossing bracketed by the samples at 'ta' and 'tb'.
+      float refineIsosurfaceHit(const Ray &ray,
+                                float isovalue,
+                                float ta, float va,
+                                float tb, float vb) const;
     };
 
   } // ::ospray::cpp_renderer